@@ -51,6 +51,38 @@ def run_demo():
     if os.path.exists(restored_file):
         os.remove(restored_file)
 
+def run_array_demo():
+    print("--- Running NumPy Array Round Trip ---")
+    try:
+        import numpy as np
+    except ImportError:
+        print("[Python] NumPy is not installed; skipping the array round trip.")
+        return
+
+    # A strided, transposed view (compress_array copies it to C order),
+    # a big-endian structured dtype (restored through descr_to_dtype), a
+    # zero-length array and a 0-d array
+    grid = np.sin(np.arange(8 * 6 * 5, dtype=np.float64)).reshape(8, 6, 5)
+    strided = grid[::2, :, 1:4].transpose(2, 0, 1)
+    record = np.dtype([('id', '>i4'), ('pos', '<f4', (3,)), ('flag', 'u1')])
+    records = np.zeros((4, 7), dtype=record)[:, ::2]
+    records['id'] = np.arange(records.size).reshape(records.shape)
+    records['pos'] = 0.5
+    cases = {
+        'non-contiguous float64': strided,
+        'structured big-endian': records,
+        'zero-length': np.zeros((0, 3), dtype=np.float32),
+        '0-d': np.array(2.5),
+    }
+
+    for name, original in cases.items():
+        restored = wrapper.decompress_array(wrapper.compress_array(original))
+        same = (restored.dtype == original.dtype and restored.shape == original.shape and
+                np.array_equal(restored, original))
+        status = "SUCCESS" if same else "FAILURE"
+        print(f"{status}: {name} array {original.shape} {original.dtype} "
+              f"(C-contiguous: {original.flags.c_contiguous})")
+
 if __name__ == "__main__":
     # Ensure the C library is built first
     # We are in the /python directory, so we look in ../bin/
@@ -59,4 +91,5 @@ if __name__ == "__main__":
         print("Error: 'bin/libhuffman.so' not found.")
         print("Please run 'make lib' or 'make all' in the root directory first.")
     else:
-        run_demo()
\ No newline at end of file
+        run_demo()
+        run_array_demo()
\ No newline at end of file
@@ -0,0 +1,160 @@
+"""
+Smoke test of wrapper.py: a round trip through each of its functions. By
+default they go through the native extension; with --ctypes the extension
+is hidden and they fall back to ctypes. `make test` builds the library and
+the extension, then runs both.
+"""
+import array
+import contextlib
+import os
+import sys
+import tempfile
+import unittest
+
+USE_CTYPES = '--ctypes' in sys.argv
+if USE_CTYPES:
+    sys.argv.remove('--ctypes')
+    sys.modules['_huffman'] = None  # Makes wrapper's 'import _huffman' fail
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import wrapper
+
+TEXT = b''.join(b'line %d: the quick brown fox jumps over the lazy dog\n' % i for i in range(5000))
+
+@contextlib.contextmanager
+def quiet():
+    """Silences the library's (and the wrapper's) progress messages."""
+    sys.stdout.flush()
+    sys.stderr.flush()
+    saved = [os.dup(1), os.dup(2)]
+    with open(os.devnull, 'w') as null:
+        os.dup2(null.fileno(), 1)
+        os.dup2(null.fileno(), 2)
+    try:
+        yield
+    finally:
+        sys.stdout.flush()
+        sys.stderr.flush()
+        os.dup2(saved[0], 1)
+        os.dup2(saved[1], 2)
+        os.close(saved[0])
+        os.close(saved[1])
+
+class WrapperTest(unittest.TestCase):
+    w = wrapper
+
+    def setUp(self):
+        quietness = quiet()
+        quietness.__enter__()
+        self.addCleanup(quietness.__exit__, None, None, None)
+        tmp = tempfile.TemporaryDirectory()
+        self.addCleanup(tmp.cleanup)
+        self.dir = tmp.name
+
+    def path(self, name):
+        return os.path.join(self.dir, name)
+
+    def test_bytes(self):
+        for data in (b'', b'x', TEXT, bytearray(TEXT), memoryview(TEXT)[100:2000], bytes(range(256)) * 50):
+            compressed = self.w.compress_bytes(data)
+            self.assertEqual(self.w.decompress_bytes(compressed), bytes(data))
+            self.assertEqual(self.w.decompress_bytes(bytearray(compressed)), bytes(data))
+        compressed = self.w.compress_bytes(TEXT)
+        with self.assertRaises(ValueError):
+            self.w.decompress_bytes(TEXT[:100])
+        with self.assertRaises(ValueError):
+            self.w.decompress_bytes(compressed[:len(compressed) // 2])
+
+    def test_files(self):
+        source, packed, restored = self.path('in.txt'), self.path('in.huff'), self.path('out.txt')
+        with open(source, 'wb') as f:
+            f.write(TEXT)
+        self.assertTrue(self.w.compress(source, packed))
+        self.assertTrue(self.w.decompress(packed, restored))
+        with open(restored, 'rb') as f:
+            self.assertEqual(f.read(), TEXT)
+        with open(packed, 'rb') as f:
+            self.assertEqual(self.w.decompress_bytes(f.read()), TEXT)
+        self.assertFalse(self.w.compress(self.path('missing'), packed))
+        self.assertFalse(self.w.decompress(source, restored))
+
+    def test_arrays(self):
+        for values in (array.array('i', range(-500, 1500)), array.array('d', [i / 7 for i in range(999)]),
+                       array.array('H'), array.array('B', TEXT[:777])):
+            restored = self.w.decompress_array(self.w.compress_array(values))
+            self.assertEqual(restored.format, values.typecode)
+            self.assertEqual(restored.tolist(), values.tolist())
+        grid = memoryview(array.array('l', range(12))).cast('B').cast('l', [3, 4])
+        restored = self.w.decompress_array(self.w.compress_array(grid))
+        self.assertEqual(restored.shape, (3, 4))
+        self.assertEqual(restored.tolist(), grid.tolist())
+        with self.assertRaises(ValueError):
+            self.w.decompress_array(b'not an array')
+
+    def test_streams(self):
+        compressor = self.w.Compressor(4096)
+        parts = [compressor.compress(TEXT[i:i + 1000]) for i in range(0, len(TEXT), 1000)]
+        parts.append(compressor.flush())
+        parts.append(compressor.end())
+        compressed = b''.join(parts)
+        self.assertEqual(self.w.decompress_bytes(compressed), TEXT)
+
+        decompressor = self.w.Decompressor()
+        restored = b''.join(decompressor.decompress(compressed[i:i + 333]) for i in range(0, len(compressed), 333))
+        decompressor.end()
+        self.assertEqual(restored, TEXT)
+
+        decompressor = self.w.Decompressor()
+        decompressor.decompress(compressed[:-1])
+        with self.assertRaises(ValueError):
+            decompressor.end()
+
+    def test_file_objects(self):
+        path = self.path('lines.huff')
+        lines = ['line %d\n' % i for i in range(3000)]
+        with self.w.open_file(path, 'wt', block_size=8192) as f:
+            f.writelines(lines)
+        with self.w.open_file(path, 'rt') as f:
+            self.assertEqual(f.readlines(), lines)
+        with open(path, 'rb') as f:
+            self.assertEqual(self.w.decompress_bytes(f.read()), ''.join(lines).encode())
+
+    def test_batches(self):
+        buffers = [TEXT, b'', b'abc', bytes(range(256))]
+        compressed = self.w.compress_buffers(buffers, threads=2)
+        restored = self.w.decompress_buffers(compressed + [b'garbage'], threads=2)
+        self.assertEqual(restored, buffers + [None])
+
+        sources = [self.path('batch%d.bin' % i) for i in range(len(buffers))]
+        packed = [p + '.huff' for p in sources]
+        outputs = [p + '.out' for p in sources]
+        for path, data in zip(sources, buffers):
+            with open(path, 'wb') as f:
+                f.write(data)
+        self.assertEqual(self.w.compress_files(sources + [self.path('missing')], packed + [self.path('x.huff')],
+                                               threads=2), [True] * len(buffers) + [False])
+        self.assertEqual(self.w.decompress_files(packed, outputs, threads=2), [True] * len(buffers))
+        for path, data in zip(outputs, buffers):
+            with open(path, 'rb') as f:
+                self.assertEqual(f.read(), data)
+
+    @unittest.skipIf(USE_CTYPES, "extension hidden (--ctypes)")
+    def test_extension(self):
+        native = self.w._native
+        self.assertIsNotNone(native, "extension not built (make python)")
+        compressed = native.compress(TEXT)
+        self.assertEqual(native.decompressed_size(compressed), len(TEXT))
+        self.assertEqual(native.decompress(compressed), TEXT)
+        with self.assertRaises(ValueError):
+            native.decompress(b'garbage')
+        source, packed, restored = self.path('in.txt'), self.path('in.huff'), self.path('out.txt')
+        with open(source, 'wb') as f:
+            f.write(TEXT)
+        self.assertTrue(native.compress_file(source, packed))
+        self.assertTrue(native.decompress_file(packed, restored))
+        self.assertFalse(native.decompress_file(source, restored))
+        with open(restored, 'rb') as f:
+            self.assertEqual(f.read(), TEXT)
+
+if __name__ == '__main__':
+    unittest.main()
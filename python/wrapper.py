@@ -1,5 +1,10 @@
+import array
 import ctypes
+import io
+import json
+import math
 import os
+import struct
 import sys
 
 # --- Load the Shared Library ---
@@ -32,6 +37,21 @@ except OSError as e:
     print("This can happen if you are trying to run this on Windows *without* WSL.")
     sys.exit(1)
 
+# --- Load the Native Extension (optional) ---
+
+# `make python` builds bin/_huffman*.so, a CPython extension linked against
+# the same library. When it is there, the in-memory and streaming functions
+# below call it directly (no ctypes call overhead, GIL released while
+# coding); otherwise they fall back to ctypes.
+_bin_dir = os.path.dirname(os.path.abspath(lib_path))
+sys.path.insert(0, _bin_dir)
+try:
+    import _huffman as _native
+except ImportError:
+    _native = None
+finally:
+    sys.path.remove(_bin_dir)
+
 
 # --- Define Function Prototypes (ArgTypes and ResType) ---
 
@@ -45,6 +65,136 @@ libhuffman.api_compress_file.restype = ctypes.c_int
 libhuffman.api_decompress_file.argtypes = [ctypes.c_char_p, ctypes.c_char_p]
 libhuffman.api_decompress_file.restype = ctypes.c_int
 
+# size_t api_compress_bound(size_t size);
+libhuffman.api_compress_bound.argtypes = [ctypes.c_size_t]
+libhuffman.api_compress_bound.restype = ctypes.c_size_t
+
+# long long api_compress_buffer(const unsigned char* src, size_t srcSize, unsigned char* dest, size_t destCapacity);
+libhuffman.api_compress_buffer.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_size_t]
+libhuffman.api_compress_buffer.restype = ctypes.c_longlong
+
+# long long api_decompressed_size(const unsigned char* src, size_t srcSize);
+libhuffman.api_decompressed_size.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+libhuffman.api_decompressed_size.restype = ctypes.c_longlong
+
+# long long api_decompress_buffer(const unsigned char* src, size_t srcSize, unsigned char* dest, size_t destCapacity);
+libhuffman.api_decompress_buffer.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_size_t]
+libhuffman.api_decompress_buffer.restype = ctypes.c_longlong
+
+# size_t api_compress_shuffled_bound(size_t size, size_t elementSize);
+libhuffman.api_compress_shuffled_bound.argtypes = [ctypes.c_size_t, ctypes.c_size_t]
+libhuffman.api_compress_shuffled_bound.restype = ctypes.c_size_t
+
+# long long api_compress_shuffled(const unsigned char* src, size_t srcSize, size_t elementSize,
+#                                 unsigned char* dest, size_t destCapacity);
+libhuffman.api_compress_shuffled.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_size_t,
+                                             ctypes.c_void_p, ctypes.c_size_t]
+libhuffman.api_compress_shuffled.restype = ctypes.c_longlong
+
+# void api_free_buffer(unsigned char* buffer);
+libhuffman.api_free_buffer.argtypes = [ctypes.c_void_p]
+libhuffman.api_free_buffer.restype = None
+
+# int api_compress_files(const char* const* inputPaths, const char* const* outputPaths,
+#                        int count, int threads, int* results);  (and api_decompress_files)
+for _fn in (libhuffman.api_compress_files, libhuffman.api_decompress_files):
+    _fn.argtypes = [ctypes.POINTER(ctypes.c_char_p), ctypes.POINTER(ctypes.c_char_p),
+                    ctypes.c_int, ctypes.c_int, ctypes.POINTER(ctypes.c_int)]
+    _fn.restype = ctypes.c_int
+
+# int api_compress_buffers(const unsigned char* const* srcs, const size_t* srcSizes, int count,
+#                          int threads, unsigned char** outputs, size_t* outputSizes);
+#                          (and api_decompress_buffers)
+for _fn in (libhuffman.api_compress_buffers, libhuffman.api_decompress_buffers):
+    _fn.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_size_t), ctypes.c_int,
+                    ctypes.c_int, ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_size_t)]
+    _fn.restype = ctypes.c_int
+
+# Streaming compression: CompressStream* api_compress_stream_create(unsigned long long blockSize); ...
+libhuffman.api_compress_stream_create.argtypes = [ctypes.c_ulonglong]
+libhuffman.api_compress_stream_create.restype = ctypes.c_void_p
+libhuffman.api_compress_stream_feed.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t,
+                                                ctypes.POINTER(ctypes.c_void_p)]
+libhuffman.api_compress_stream_feed.restype = ctypes.c_longlong
+for _fn in (libhuffman.api_compress_stream_flush, libhuffman.api_compress_stream_end):
+    _fn.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_void_p)]
+    _fn.restype = ctypes.c_longlong
+libhuffman.api_compress_stream_free.argtypes = [ctypes.c_void_p]
+libhuffman.api_compress_stream_free.restype = None
+
+# Streaming decompression: DecompressStream* api_decompress_stream_create(void); ...
+libhuffman.api_decompress_stream_create.argtypes = []
+libhuffman.api_decompress_stream_create.restype = ctypes.c_void_p
+libhuffman.api_decompress_stream_feed.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t,
+                                                  ctypes.POINTER(ctypes.c_void_p)]
+libhuffman.api_decompress_stream_feed.restype = ctypes.c_longlong
+libhuffman.api_decompress_stream_end.argtypes = [ctypes.c_void_p]
+libhuffman.api_decompress_stream_end.restype = ctypes.c_int
+libhuffman.api_decompress_stream_free.argtypes = [ctypes.c_void_p]
+libhuffman.api_decompress_stream_free.restype = None
+
+
+# --- Buffer Protocol Access ---
+
+# ctypes can only point into writable buffers (from_buffer), so read-only
+# ones (bytes slices, memoryviews, read-only mmaps) are borrowed through the
+# C API instead. Either way the library reads the caller's memory directly.
+
+class _PyBuffer(ctypes.Structure):
+    # Py_buffer from CPython's Include/pybuffer.h
+    _fields_ = [
+        ('buf', ctypes.c_void_p),
+        ('obj', ctypes.c_void_p),
+        ('len', ctypes.c_ssize_t),
+        ('itemsize', ctypes.c_ssize_t),
+        ('readonly', ctypes.c_int),
+        ('ndim', ctypes.c_int),
+        ('format', ctypes.c_char_p),
+        ('shape', ctypes.c_void_p),
+        ('strides', ctypes.c_void_p),
+        ('suboffsets', ctypes.c_void_p),
+        ('internal', ctypes.c_void_p),
+    ]
+
+_PyBUF_SIMPLE = 0  # Contiguous bytes, read-only is fine
+
+ctypes.pythonapi.PyObject_GetBuffer.argtypes = [ctypes.py_object, ctypes.POINTER(_PyBuffer), ctypes.c_int]
+ctypes.pythonapi.PyObject_GetBuffer.restype = ctypes.c_int
+ctypes.pythonapi.PyBuffer_Release.argtypes = [ctypes.POINTER(_PyBuffer)]
+ctypes.pythonapi.PyBuffer_Release.restype = None
+
+# An uninitialized bytes object to decompress into: it is filled before
+# any other code sees it, so no bytearray-to-bytes copy is needed
+ctypes.pythonapi.PyBytes_FromStringAndSize.argtypes = [ctypes.c_void_p, ctypes.c_ssize_t]
+ctypes.pythonapi.PyBytes_FromStringAndSize.restype = ctypes.py_object
+ctypes.pythonapi.PyBytes_AsString.argtypes = [ctypes.py_object]
+ctypes.pythonapi.PyBytes_AsString.restype = ctypes.c_void_p
+
+
+class _BorrowedBuffer:
+    """
+    Holds a buffer-protocol object's memory for the length of a 'with'
+    block, exposing its address ('pointer') and size. Raises BufferError
+    for non-contiguous buffers (e.g. strided memoryviews).
+    """
+
+    def __init__(self, data):
+        self._view = _PyBuffer()
+        self._held = False
+        ctypes.pythonapi.PyObject_GetBuffer(data, ctypes.byref(self._view), _PyBUF_SIMPLE)
+        self._held = True
+        self.pointer = self._view.buf
+        self.size = self._view.len
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        if self._held:
+            ctypes.pythonapi.PyBuffer_Release(ctypes.byref(self._view))
+            self._held = False
+        return False
+
 
 # --- Create Friendly Python Wrapper Functions ---
 
@@ -102,6 +252,470 @@ def decompress(input_path: str, output_path: str) -> bool:
         print("[Python] C decompression failed.")
         return False
 
+def compress_bytes(data) -> bytes:
+    """
+    Compresses an in-memory buffer with the C Huffman library.
+
+    Args:
+        data: Any buffer-protocol object (bytes, bytearray, memoryview,
+            mmap, array.array, ...). It is read in place, not copied.
+
+    Returns:
+        bytes: The compressed data, in the same format as compress() writes.
+    """
+    if _native:
+        return _native.compress(data)
+    with _BorrowedBuffer(data) as src:
+        capacity = libhuffman.api_compress_bound(src.size)
+        dest = ctypes.create_string_buffer(capacity)
+        n = libhuffman.api_compress_buffer(src.pointer, src.size, dest, capacity)
+    if n < 0:
+        raise ValueError("Huffman compression failed")
+    return ctypes.string_at(dest, n)
+
+def decompress_bytes(data) -> bytes:
+    """
+    Decompresses an in-memory buffer with the C Huffman library.
+
+    Args:
+        data: Any buffer-protocol object holding compressed data (output of
+            compress_bytes, or the contents of a .huff file). It is read in
+            place, not copied.
+
+    Returns:
+        bytes: The original data. The result is allocated once, at the size
+        stored in the header, and decoded straight into.
+
+    Raises:
+        ValueError: If the data is not valid compressed data.
+    """
+    if _native:
+        return _native.decompress(data)
+    with _BorrowedBuffer(data) as src:
+        size = libhuffman.api_decompressed_size(src.pointer, src.size)
+        if size < 0:
+            raise ValueError("Not a valid compressed buffer or buffer is corrupted")
+        result = ctypes.pythonapi.PyBytes_FromStringAndSize(None, size)
+        # b'' is a shared singleton: never write to it
+        dest = ctypes.pythonapi.PyBytes_AsString(result) if size > 0 else None
+        n = libhuffman.api_decompress_buffer(src.pointer, src.size, dest, size)
+    if n != size:
+        raise ValueError("Compressed data is truncated or corrupted")
+    return result
+
+# --- Arrays ---
+
+# Array header: magic, metadata length, then the metadata as JSON. The
+# compressed elements follow, in the format api_compress_shuffled writes.
+_ARRAY_MAGIC = b'HUFA'
+_ARRAY_HEADER = struct.Struct('<4sI')
+_MAX_ELEMENT_SIZE = 256  # HUFF_MAX_ELEMENT_SIZE
+
+def _is_ndarray(obj) -> bool:
+    # An ndarray means NumPy is already imported
+    np = sys.modules.get('numpy')
+    return np is not None and isinstance(obj, np.ndarray)
+
+def compress_array(array) -> bytes:
+    """
+    Compresses an array of fixed-width elements. The bytes are split into
+    byte planes (byte k of every element) in C and each plane is coded with
+    its own table, which suits numeric data: the high bytes of neighbouring
+    values are alike even when the low bytes are noise.
+
+    Args:
+        array: A NumPy array (any shape, dtype and memory order), or any
+            other buffer-protocol object (array.array, memoryview, ...).
+            C-contiguous data is read in place, not copied.
+
+    Returns:
+        bytes: The compressed array, with its dtype (or buffer format) and
+        shape, for decompress_array.
+
+    Raises:
+        ValueError: If the array holds Python objects.
+    """
+    if _is_ndarray(array):
+        import numpy as np
+        if array.dtype.hasobject:
+            raise ValueError("Arrays of Python objects cannot be compressed")
+        # The shape is taken first: ascontiguousarray turns 0-d arrays into 1-d
+        meta = {'dtype': np.lib.format.dtype_to_descr(array.dtype), 'shape': list(array.shape)}
+        itemsize = array.dtype.itemsize
+        # Flat bytes, so any dtype goes through the buffer protocol
+        array = np.ascontiguousarray(array).reshape(-1).view(np.uint8)
+    else:
+        view = memoryview(array)
+        if not view.c_contiguous:
+            view = memoryview(view.tobytes()).cast('B').cast(view.format, view.shape)
+        meta = {'format': view.format, 'shape': list(view.shape)}
+        itemsize = view.itemsize
+        array = view
+    width = itemsize if 0 < itemsize <= _MAX_ELEMENT_SIZE else 1
+    header = json.dumps(meta).encode('utf-8')
+
+    with _BorrowedBuffer(array) as src:
+        capacity = libhuffman.api_compress_shuffled_bound(src.size, width)
+        dest = ctypes.create_string_buffer(capacity)
+        n = libhuffman.api_compress_shuffled(src.pointer, src.size, width, dest, capacity)
+    if n < 0:
+        raise ValueError("Huffman compression failed")
+    return _ARRAY_HEADER.pack(_ARRAY_MAGIC, len(header)) + header + ctypes.string_at(dest, n)
+
+def decompress_array(data):
+    """
+    Decompresses the output of compress_array.
+
+    Args:
+        data: Any buffer-protocol object holding a compressed array. It is
+            read in place, not copied.
+
+    Returns:
+        A NumPy array with the original dtype and shape, decoded straight
+        into its memory. Arrays compressed from other buffers come back as
+        a memoryview with the original format and shape.
+
+    Raises:
+        ValueError: If the data is not a valid compressed array.
+    """
+    view = memoryview(data).cast('B')
+    if len(view) < _ARRAY_HEADER.size:
+        raise ValueError("Not a valid compressed array")
+    magic, meta_size = _ARRAY_HEADER.unpack_from(view)
+    start = _ARRAY_HEADER.size + meta_size
+    if magic != _ARRAY_MAGIC or start > len(view):
+        raise ValueError("Not a valid compressed array")
+    try:
+        meta = json.loads(bytes(view[_ARRAY_HEADER.size:start]).decode('utf-8'))
+        shape = [int(n) for n in meta['shape']]
+    except (ValueError, KeyError, TypeError):
+        raise ValueError("Not a valid compressed array") from None
+
+    # The destination, allocated at its final size
+    if 'dtype' in meta:
+        import numpy as np
+        from numpy.lib.format import descr_to_dtype
+        result = np.empty(shape, dtype=descr_to_dtype(meta['dtype']))
+        nbytes = result.nbytes
+        pointer = result.ctypes.data if nbytes > 0 else None
+    else:
+        nbytes = struct.calcsize(meta['format']) * math.prod(shape)
+        result = bytearray(nbytes)
+        pointer = ctypes.addressof((ctypes.c_char * nbytes).from_buffer(result)) if nbytes > 0 else None
+
+    with _BorrowedBuffer(view[start:]) as src:
+        size = libhuffman.api_decompressed_size(src.pointer, src.size)
+        if size != nbytes:
+            raise ValueError("Not a valid compressed array")
+        n = libhuffman.api_decompress_buffer(src.pointer, src.size, pointer, nbytes)
+    if n != nbytes:
+        raise ValueError("Compressed data is truncated or corrupted")
+    if 'dtype' in meta:
+        return result
+    if nbytes == 0:
+        # memoryview cannot cast to a shape with zeros: empty arrays come back flat
+        return memoryview(array.array(meta['format']) if meta['format'] in array.typecodes else result)
+    return memoryview(result).cast(meta['format'], shape)
+
+# --- Streaming ---
+
+class Compressor:
+    """
+    Incremental compression into a block container, for input of unknown
+    length (see the C Streaming API). Each call returns the compressed
+    bytes it produced, possibly b''.
+
+    Args:
+        block_size (int): Uncompressed bytes per block (0 = 1 MB).
+    """
+
+    def __init__(self, block_size: int = 0):
+        self._stream = libhuffman.api_compress_stream_create(block_size)
+        if not self._stream:
+            raise ValueError("Invalid block size")
+
+    def _output(self, n, out):
+        if n < 0:
+            raise ValueError("Huffman compression failed (compressor already ended?)")
+        return ctypes.string_at(out, n)
+
+    def compress(self, data) -> bytes:
+        """Feeds data; returns the compressed bytes of the blocks it completed."""
+        out = ctypes.c_void_p()
+        with _BorrowedBuffer(data) as src:
+            n = libhuffman.api_compress_stream_feed(self._stream, src.pointer, src.size, ctypes.byref(out))
+        return self._output(n, out)
+
+    def flush(self) -> bytes:
+        """Codes the data fed so far, so a reader can decode all of it."""
+        out = ctypes.c_void_p()
+        return self._output(libhuffman.api_compress_stream_flush(self._stream, ctypes.byref(out)), out)
+
+    def end(self) -> bytes:
+        """Flushes and writes the end marker; the compressor takes no more input."""
+        out = ctypes.c_void_p()
+        return self._output(libhuffman.api_compress_stream_end(self._stream, ctypes.byref(out)), out)
+
+    def __del__(self):
+        if getattr(self, '_stream', None):
+            libhuffman.api_compress_stream_free(self._stream)
+            self._stream = None
+
+class Decompressor:
+    """
+    Incremental decompression of block containers. Each call returns the
+    bytes of the blocks completed so far, possibly b''.
+    """
+
+    def __init__(self):
+        self._stream = libhuffman.api_decompress_stream_create()
+
+    def decompress(self, data) -> bytes:
+        """Feeds compressed data; returns the bytes of the blocks it completed."""
+        out = ctypes.c_void_p()
+        with _BorrowedBuffer(data) as src:
+            n = libhuffman.api_decompress_stream_feed(self._stream, src.pointer, src.size, ctypes.byref(out))
+        if n < 0:
+            raise ValueError("Compressed data is truncated or corrupted")
+        return ctypes.string_at(out, n)
+
+    def end(self) -> None:
+        """Raises ValueError unless the whole container was fed."""
+        if libhuffman.api_decompress_stream_end(self._stream) != 0:
+            raise ValueError("Compressed data is truncated or corrupted")
+
+    def __del__(self):
+        if getattr(self, '_stream', None):
+            libhuffman.api_decompress_stream_free(self._stream)
+            self._stream = None
+
+# The extension's types have the same interface
+if _native:
+    Compressor = _native.Compressor
+    Decompressor = _native.Decompressor
+
+# --- File-Like Objects ---
+
+# Raw streams over Compressor/Decompressor: memory stays bounded by the
+# block size however long the data is. Wrap them in io.BufferedReader /
+# io.TextIOWrapper (or use open_file) for line reading, csv, json, tarfile...
+
+_READ_CHUNK_SIZE = 64 * 1024  # Compressed bytes read from the source at a time
+
+def _open_target(target, mode):
+    """Returns (file object, whether we opened it) for a path or a file object."""
+    if isinstance(target, (str, bytes, os.PathLike)):
+        return io.open(target, mode), True
+    return target, False
+
+class HuffmanWriter(io.RawIOBase):
+    """
+    Writable raw stream: compresses what is written to it into a block
+    container on 'target' (a path, or a binary file object). close() writes
+    the end marker; the output decompresses with decompress(),
+    decompress_bytes() or HuffmanReader.
+
+    Args:
+        target: Path or writable binary file object.
+        block_size (int): Uncompressed bytes per block (0 = 1 MB).
+    """
+
+    def __init__(self, target, block_size: int = 0):
+        super().__init__()
+        self._compressor = Compressor(block_size)
+        self._file, self._owns_file = _open_target(target, 'wb')
+
+    def writable(self) -> bool:
+        return True
+
+    def write(self, data) -> int:
+        if self.closed:
+            raise ValueError("I/O operation on closed file")
+        with memoryview(data) as view:
+            size = view.nbytes
+            out = self._compressor.compress(view)
+        if out:
+            self._file.write(out)
+        return size
+
+    def flush(self) -> None:
+        """Flushes the target file. Data of a partial block stays pending (see flush_block)."""
+        if not self.closed:
+            self._file.flush()
+
+    def flush_block(self) -> None:
+        """Codes the data written so far as a (short) block, so a reader can decode all of it."""
+        out = self._compressor.flush()
+        if out:
+            self._file.write(out)
+        self._file.flush()
+
+    def close(self) -> None:
+        if self.closed:
+            return
+        try:
+            self._file.write(self._compressor.end())
+        finally:
+            try:
+                super().close()  # Flushes the target first
+            finally:
+                if self._owns_file:
+                    self._file.close()
+
+class HuffmanReader(io.RawIOBase):
+    """
+    Readable raw stream: decompresses a block container (as written by
+    HuffmanWriter, or by compress() in block mode) from 'source', a path or
+    a binary file object. Reading past the end of truncated data raises
+    ValueError.
+
+    Args:
+        source: Path or readable binary file object.
+    """
+
+    def __init__(self, source):
+        super().__init__()
+        self._decompressor = Decompressor()
+        self._file, self._owns_file = _open_target(source, 'rb')
+        self._pending = memoryview(b'')
+        self._eof = False
+
+    def readable(self) -> bool:
+        return True
+
+    def readinto(self, buffer) -> int:
+        if self.closed:
+            raise ValueError("I/O operation on closed file")
+        # Decode more only once the last blocks have been handed out
+        while not self._pending and not self._eof:
+            chunk = self._file.read(_READ_CHUNK_SIZE)
+            if not chunk:
+                self._eof = True
+                self._decompressor.end()
+                break
+            self._pending = memoryview(self._decompressor.decompress(chunk))
+        with memoryview(buffer) as view, view.cast('B') as dest:
+            n = min(len(dest), len(self._pending))
+            dest[:n] = self._pending[:n]
+        self._pending = self._pending[n:]
+        return n
+
+    def close(self) -> None:
+        if self.closed:
+            return
+        try:
+            super().close()
+        finally:
+            if self._owns_file:
+                self._file.close()
+
+def open_file(path, mode: str = 'rb', block_size: int = 0, encoding=None, errors=None, newline=None):
+    """
+    Opens a compressed file like the built-in open(): 'rb'/'wb' give a
+    buffered binary stream, 'rt'/'wt' a text stream.
+
+    Args:
+        path: Path or binary file object.
+        mode (str): 'rb', 'wb', 'rt', 'wt' (or 'r'/'w', meaning binary).
+        block_size (int): Uncompressed bytes per block when writing (0 = 1 MB).
+    """
+    if mode.replace('b', '').replace('t', '') not in ('r', 'w') or ('b' in mode and 't' in mode):
+        raise ValueError(f"Invalid mode '{mode}'")
+    if 'r' in mode:
+        stream = io.BufferedReader(HuffmanReader(path), _READ_CHUNK_SIZE)
+    else:
+        stream = io.BufferedWriter(HuffmanWriter(path, block_size), _READ_CHUNK_SIZE)
+    if 't' in mode:
+        return io.TextIOWrapper(stream, encoding=encoding, errors=errors, newline=newline)
+    return stream
+
+# --- Batches ---
+
+# One ctypes call per batch: the library runs the items on its own worker
+# pool (the call releases the GIL), so Python waits once for all of them.
+
+def _run_file_batch(fn, input_paths, output_paths, threads):
+    if len(input_paths) != len(output_paths):
+        raise ValueError("input_paths and output_paths differ in length")
+    count = len(input_paths)
+    c_inputs = (ctypes.c_char_p * count)(*[os.fsencode(p) for p in input_paths])
+    c_outputs = (ctypes.c_char_p * count)(*[os.fsencode(p) for p in output_paths])
+    results = (ctypes.c_int * count)()
+    if fn(c_inputs, c_outputs, count, threads, results) < 0:
+        raise ValueError("Invalid batch")
+    return [r == 0 for r in results]
+
+def compress_files(input_paths, output_paths, threads: int = 0) -> list:
+    """
+    Compresses many files in one call, in parallel.
+
+    Args:
+        input_paths (list): Paths of the files to compress.
+        output_paths (list): Where to write each compressed file.
+        threads (int): Worker threads (0 = one per CPU).
+
+    Returns:
+        list: One bool per file, True on success.
+    """
+    return _run_file_batch(libhuffman.api_compress_files, input_paths, output_paths, threads)
+
+def decompress_files(input_paths, output_paths, threads: int = 0) -> list:
+    """
+    Decompresses many files in one call, in parallel.
+
+    Returns:
+        list: One bool per file, True on success.
+    """
+    return _run_file_batch(libhuffman.api_decompress_files, input_paths, output_paths, threads)
+
+def _run_buffer_batch(fn, buffers, threads):
+    count = len(buffers)
+    borrowed = []
+    try:
+        for data in buffers:
+            borrowed.append(_BorrowedBuffer(data))
+        srcs = (ctypes.c_void_p * count)(*[b.pointer for b in borrowed])
+        sizes = (ctypes.c_size_t * count)(*[b.size for b in borrowed])
+        outputs = (ctypes.c_void_p * count)()
+        output_sizes = (ctypes.c_size_t * count)()
+        if fn(srcs, sizes, count, threads, outputs, output_sizes) < 0:
+            raise ValueError("Invalid batch")
+    finally:
+        for b in borrowed:
+            b.__exit__(None, None, None)
+
+    results = []
+    for pointer, size in zip(outputs, output_sizes):
+        if pointer is None:
+            results.append(None)
+            continue
+        results.append(ctypes.string_at(pointer, size))
+        libhuffman.api_free_buffer(pointer)
+    return results
+
+def compress_buffers(buffers, threads: int = 0) -> list:
+    """
+    Compresses many in-memory buffers in one call, in parallel.
+
+    Args:
+        buffers (list): Buffer-protocol objects, read in place.
+        threads (int): Worker threads (0 = one per CPU).
+
+    Returns:
+        list: The compressed bytes of each buffer.
+    """
+    return _run_buffer_batch(libhuffman.api_compress_buffers, buffers, threads)
+
+def decompress_buffers(buffers, threads: int = 0) -> list:
+    """
+    Decompresses many in-memory buffers in one call, in parallel.
+
+    Returns:
+        list: The original bytes of each buffer, or None where a buffer
+        is not valid compressed data.
+    """
+    return _run_buffer_batch(libhuffman.api_decompress_buffers, buffers, threads)
+
 # This allows other Python scripts to import these functions
 if __name__ == '__main__':
     print("This is a wrapper module. Run demo.py to see it in action.")
\ No newline at end of file
@@ -0,0 +1,349 @@
+// Benchmark harness: compresses and decompresses a corpus through the
+// buffer API and reports throughput, ratio, per-call latency and peak
+// memory, one JSON object per line on stdout.
+#include "huffman.h"
+#include "cli.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define DEFAULT_RUNS 20
+#define DEFAULT_SYNTHETIC_SIZE (4 * 1024 * 1024)
+
+static void printUsage(void) {
+    fprintf(stderr, "Usage: ./bin/huffman_bench [options] [files...]\n");
+    fprintf(stderr, "Runs test_files/sample.txt, test_files/sample_large.txt and synthetic data\n");
+    fprintf(stderr, "unless files are given.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --runs=N            : Timed calls per operation (default: %d)\n", DEFAULT_RUNS);
+    fprintf(stderr, "  --size=N            : Size of each synthetic input (default: 4M; K/M/G suffixes)\n");
+    fprintf(stderr, "  --no-synthetic      : Skip the synthetic inputs\n");
+    fprintf(stderr, "  --block-size=N      : Compress in blocks of N bytes\n");
+    fprintf(stderr, "  --threads=N         : Worker threads for block mode\n");
+    fprintf(stderr, "  --streams=N         : Bit streams per block, 1 or 4\n");
+    fprintf(stderr, "  --max-code-length=N : Longest code in bits, 8-15\n");
+    fprintf(stderr, "  --decoder=D         : Decode with 'table', 'tree' or 'both' (default: both)\n");
+}
+
+// Wall-clock time in nanoseconds
+static unsigned long long nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+// Peak resident set size of the process so far, in KB
+static long peakRssKb(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+    return usage.ru_maxrss;
+}
+
+// --- Corpus ---
+
+typedef struct BenchInput {
+    char name[64];
+    unsigned char* data;
+    size_t size;
+} BenchInput;
+
+// Deterministic generator (xorshift64*), so every run sees the same data
+static unsigned long long nextRandom(unsigned long long* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+static unsigned char* allocInput(size_t size) {
+    unsigned char* data = (unsigned char*)malloc(size + 1);
+    if (!data) {
+        perror("malloc error (allocInput)");
+        exit(EXIT_FAILURE);
+    }
+    return data;
+}
+
+static int loadFile(const char* path, BenchInput* input) {
+    FILE* in = fopen(path, "rb");
+    if (!in) {
+        perror("Failed to open input file");
+        return -1;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    rewind(in);
+    if (size < 0) {
+        fclose(in);
+        return -1;
+    }
+    input->data = allocInput((size_t)size);
+    input->size = fread(input->data, 1, (size_t)size, in);
+    fclose(in);
+
+    const char* base = strrchr(path, '/');
+    snprintf(input->name, sizeof(input->name), "%s", base ? base + 1 : path);
+    return 0;
+}
+
+// Synthetic distributions:
+//   uniform - every byte value equally likely (incompressible)
+//   zipf    - byte k with probability proportional to 1 / (k + 1)
+//   runs    - random byte values repeated 1 to 128 times
+//   single  - one byte value only
+static void generateInput(const char* kind, size_t size, BenchInput* input) {
+    unsigned long long state = 0x9E3779B97F4A7C15ull;
+    unsigned char* data = allocInput(size);
+
+    if (strcmp(kind, "uniform") == 0) {
+        for (size_t i = 0; i < size; ++i) data[i] = (unsigned char)(nextRandom(&state) >> 56);
+    } else if (strcmp(kind, "zipf") == 0) {
+        // Cumulative weights, scaled to 32 bits, then a binary search per byte
+        double weights[256], total = 0;
+        for (int k = 0; k < 256; ++k) total += weights[k] = 1.0 / (k + 1);
+        unsigned long long cumulative[256];
+        double sum = 0;
+        for (int k = 0; k < 256; ++k) {
+            sum += weights[k];
+            cumulative[k] = (unsigned long long)(sum / total * 4294967296.0);
+        }
+        cumulative[255] = 1ull << 32;
+        for (size_t i = 0; i < size; ++i) {
+            unsigned long long r = nextRandom(&state) >> 32;
+            int lo = 0, hi = 255;
+            while (lo < hi) {
+                int mid = (lo + hi) / 2;
+                if (cumulative[mid] > r) hi = mid; else lo = mid + 1;
+            }
+            data[i] = (unsigned char)lo;
+        }
+    } else if (strcmp(kind, "runs") == 0) {
+        size_t i = 0;
+        while (i < size) {
+            unsigned long long r = nextRandom(&state);
+            size_t run = 1 + (size_t)((r >> 8) % 128);
+            if (run > size - i) run = size - i;
+            memset(data + i, (int)(r >> 56), run);
+            i += run;
+        }
+    } else {
+        memset(data, 'a', size);
+    }
+
+    snprintf(input->name, sizeof(input->name), "synthetic:%s", kind);
+    input->data = data;
+    input->size = size;
+}
+
+// --- Measurement ---
+
+static int compareNs(const void* a, const void* b) {
+    unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentileUs(const unsigned long long* sorted, int count, int percent) {
+    int rank = (count * percent + 99) / 100;
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1] / 1000.0;
+}
+
+// Prints 'text' as a JSON string: quoted, with quotes, backslashes and
+// control characters escaped (file names may hold any of them)
+static void printJsonString(const char* text) {
+    putchar('"');
+    for (const unsigned char* c = (const unsigned char*)text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            printf("\\%c", *c);
+        } else if (*c < 0x20) {
+            printf("\\u%04x", *c);
+        } else {
+            putchar(*c);
+        }
+    }
+    putchar('"');
+}
+
+// Prints one operation's line; 'decoder' is NULL for compression
+static void printResult(const BenchInput* input, const char* op, const char* decoder, size_t compressedSize,
+                        unsigned long long* samples, int runs) {
+    unsigned long long total = 0;
+    for (int r = 0; r < runs; ++r) total += samples[r];
+    qsort(samples, runs, sizeof(samples[0]), compareNs);
+    double seconds = total / 1e9;
+    double mbPerS = seconds > 0 ? (double)input->size * runs / seconds / 1e6 : 0;
+
+    printf("{\"input\":");
+    printJsonString(input->name);
+    printf(",\"op\":\"%s\"", op);
+    if (decoder) printf(",\"decoder\":\"%s\"", decoder);
+    printf(",\"bytes\":%zu,\"compressed_bytes\":%zu,"
+           "\"ratio\":%.4f,\"runs\":%d,\"mb_per_s\":%.1f,\"p50_us\":%.1f,\"p99_us\":%.1f,"
+           "\"peak_rss_kb\":%ld}\n",
+           input->size, compressedSize,
+           input->size ? (double)compressedSize / input->size : 0.0, runs, mbPerS,
+           percentileUs(samples, runs, 50), percentileUs(samples, runs, 99), peakRssKb());
+    fflush(stdout);
+}
+
+// Times 'runs' decompress calls with one decoder and checks the round
+// trip. Returns 0, or -1 if the output does not match.
+static int benchDecoder(const BenchInput* input, DecoderMode mode, const unsigned char* compressed,
+                        size_t compressedSize, unsigned char* restored, unsigned long long* samples, int runs) {
+    const char* name = (mode == DECODER_TABLE) ? "table" : "tree";
+    setDecoderMode(mode);
+    long long restoredSize = 0;
+    for (int r = 0; r < runs; ++r) {
+        unsigned long long start = nowNs();
+        restoredSize = decompressBuffer(compressed, compressedSize, restored, input->size);
+        samples[r] = nowNs() - start;
+        if (restoredSize < 0) break;
+    }
+    if (restoredSize != (long long)input->size || memcmp(restored, input->data, input->size) != 0) {
+        fprintf(stderr, "Error: Round trip of %s with the %s decoder does not match.\n", input->name, name);
+        return -1;
+    }
+    printResult(input, "decompress", name, compressedSize, samples, runs);
+    return 0;
+}
+
+// Times 'runs' compress calls on one input, then decompress calls with
+// each decoder in 'decoders' (bit 1 << DECODER_TREE, 1 << DECODER_TABLE).
+// Returns 0, or -1 if a round trip does not match.
+static int benchInput(const BenchInput* input, int runs, int decoders) {
+    size_t capacity = compressBufferBound(input->size);
+    unsigned char* compressed = allocInput(capacity);
+    unsigned char* restored = allocInput(input->size);
+    unsigned long long* samples = (unsigned long long*)malloc(runs * sizeof(unsigned long long));
+    if (!samples) {
+        perror("malloc error (benchInput)");
+        exit(EXIT_FAILURE);
+    }
+
+    // 1. Compress
+    long long compressedSize = 0;
+    for (int r = 0; r < runs; ++r) {
+        unsigned long long start = nowNs();
+        compressedSize = compressBuffer(input->data, input->size, compressed, capacity);
+        samples[r] = nowNs() - start;
+        if (compressedSize < 0) break;
+    }
+    if (compressedSize < 0) {
+        fprintf(stderr, "Error: Compression of %s failed.\n", input->name);
+        free(samples);
+        free(restored);
+        free(compressed);
+        return -1;
+    }
+    printResult(input, "compress", NULL, (size_t)compressedSize, samples, runs);
+
+    // 2. Decompress with each decoder
+    int ok = 1;
+    if ((decoders & (1 << DECODER_TABLE)) &&
+        benchDecoder(input, DECODER_TABLE, compressed, (size_t)compressedSize, restored, samples, runs) != 0) {
+        ok = 0;
+    }
+    if ((decoders & (1 << DECODER_TREE)) &&
+        benchDecoder(input, DECODER_TREE, compressed, (size_t)compressedSize, restored, samples, runs) != 0) {
+        ok = 0;
+    }
+
+    free(samples);
+    free(restored);
+    free(compressed);
+    return ok ? 0 : -1;
+}
+
+int main(int argc, char* argv[]) {
+    int argi = 1;
+    int runs = DEFAULT_RUNS;
+    int synthetic = 1;
+    unsigned long long syntheticSize = DEFAULT_SYNTHETIC_SIZE;
+    unsigned long long blockSize = 0;
+    int threads = 0;
+    int decoders = (1 << DECODER_TABLE) | (1 << DECODER_TREE);
+    while (argi < argc && strncmp(argv[argi], "--", 2) == 0) {
+        const char* opt = argv[argi];
+        if (strncmp(opt, "--runs=", 7) == 0) {
+            runs = atoi(opt + 7);
+            if (runs < 1) {
+                fprintf(stderr, "Error: Invalid run count '%s'\n", opt + 7);
+                return 1;
+            }
+        } else if (strncmp(opt, "--size=", 7) == 0) {
+            if (parseSize(opt + 7, &syntheticSize) != 0 || syntheticSize == 0) {
+                fprintf(stderr, "Error: Invalid size '%s'\n", opt + 7);
+                return 1;
+            }
+        } else if (strcmp(opt, "--no-synthetic") == 0) {
+            synthetic = 0;
+        } else if (strncmp(opt, "--block-size=", 13) == 0) {
+            if (parseSize(opt + 13, &blockSize) != 0 || blockSize == 0 || blockSize > HUFF_MAX_BLOCK_SIZE) {
+                fprintf(stderr, "Error: Invalid block size '%s'\n", opt + 13);
+                return 1;
+            }
+        } else if (strncmp(opt, "--threads=", 10) == 0) {
+            threads = atoi(opt + 10);
+            if (threads < 1) {
+                fprintf(stderr, "Error: Invalid thread count '%s'\n", opt + 10);
+                return 1;
+            }
+        } else if (strncmp(opt, "--streams=", 10) == 0) {
+            if (api_set_stream_count(atoi(opt + 10)) != 0) return 1;
+        } else if (strncmp(opt, "--max-code-length=", 18) == 0) {
+            if (api_set_max_code_length(atoi(opt + 18)) != 0) return 1;
+        } else if (strcmp(opt, "--decoder=table") == 0) {
+            decoders = 1 << DECODER_TABLE;
+        } else if (strcmp(opt, "--decoder=tree") == 0) {
+            decoders = 1 << DECODER_TREE;
+        } else if (strcmp(opt, "--decoder=both") == 0) {
+            decoders = (1 << DECODER_TABLE) | (1 << DECODER_TREE);
+        } else {
+            fprintf(stderr, "Error: Invalid option '%s'\n", opt);
+            printUsage();
+            return 1;
+        }
+        argi++;
+    }
+    if (blockSize > 0 || threads > 0 || getStreamCount() > 1) {
+        setBlockSize(blockSize > 0 ? (size_t)blockSize : HUFF_DEFAULT_BLOCK_SIZE);
+        setThreadCount(threads);
+    }
+
+    // 1. Collect the corpus
+    static const char* defaultFiles[] = {"test_files/sample.txt", "test_files/sample_large.txt"};
+    static const char* kinds[] = {"uniform", "zipf", "runs", "single"};
+    int fileCount = (argi < argc) ? argc - argi : 2;
+    const char** files = (argi < argc) ? (const char**)(argv + argi) : defaultFiles;
+    int maxInputs = fileCount + (synthetic ? 4 : 0);
+    BenchInput* inputs = (BenchInput*)malloc(maxInputs * sizeof(BenchInput));
+    if (!inputs) {
+        perror("malloc error (main)");
+        return 1;
+    }
+    int count = 0, failed = 0;
+    for (int i = 0; i < fileCount; ++i) {
+        if (loadFile(files[i], &inputs[count]) == 0) {
+            count++;
+        } else {
+            failed = 1;
+        }
+    }
+    if (synthetic) {
+        for (int k = 0; k < 4; ++k) generateInput(kinds[k], (size_t)syntheticSize, &inputs[count++]);
+    }
+
+    // 2. Settings first, then one line per input and operation
+    printf("{\"bench\":\"huffman\",\"kernel\":\"%s\",\"block_size\":%zu,\"threads\":%d,"
+           "\"streams\":%d,\"max_code_length\":%d,\"runs\":%d}\n",
+           getKernelName(), getBlockSize(), getThreadCount(), getStreamCount(), getMaxCodeLength(), runs);
+    for (int i = 0; i < count; ++i) {
+        if (benchInput(&inputs[i], runs, decoders) != 0) failed = 1;
+        free(inputs[i].data);
+    }
+    free(inputs);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+#ifndef CLI_H
+#define CLI_H
+
+// --- Command Line Helpers ---
+// Shared by the command line tools (main.c and bench.c).
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+
+// Parses a size like 4096, 64K, 1M or 2G. Returns 0 on success, -1 on error.
+static inline int parseSize(const char* text, unsigned long long* size) {
+    char* end;
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text || errno == ERANGE) return -1;
+    int shift = 0;
+    switch (*end) {
+        case 'K': case 'k': shift = 10; end++; break;
+        case 'M': case 'm': shift = 20; end++; break;
+        case 'G': case 'g': shift = 30; end++; break;
+    }
+    if (*end != '\0' || value > (ULLONG_MAX >> shift)) return -1;
+    *size = value << shift;
+    return 0;
+}
+
+#endif // CLI_H
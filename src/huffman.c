@@ -1,447 +1,4544 @@
 #include "huffman.h"
+#include "kernels.h"
+#include "threadpool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+// The SSE2 histogram moves 64-bit lanes to general registers, which needs x86-64
+#if defined(__SSE2__) && defined(__x86_64__) && !defined(HUFF_NO_SIMD)
+#include <emmintrin.h>
+#define HUFF_SSE2_HISTOGRAM
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HUFF_HAVE_MMAP
+#endif
 
 #define MAX_TREE_HT 256 // Max height of tree (for code buffers)
 #define NUM_CHARS 256   // Number of possible ASCII/byte values
+#define IO_BUFFER_SIZE (64 * 1024) // Block size for buffered reads/writes
+#define READ_BLOCK_SIZE (1024 * 1024) // Block size for histogram reads
+#define CODE_LENGTHS_MAX_SIZE (2 + NUM_CHARS / 2) // Largest packed code length header
+#define STREAM_HEADER_SIZE 12 // Magic number and char count
+#define STATIC_HEADER_SIZE (STREAM_HEADER_SIZE + 4) // Followed by the dictionary ID
+#define SHUFFLED_HEADER_SIZE (STREAM_HEADER_SIZE + 4) // Followed by the element size
 
 // A magic number to identify our compressed file format
 // (Helps prevent decompressing the wrong file)
 const unsigned int MAGIC_NUMBER = 0x48554646; // 'HUFF'
+// Canonical format: the header carries code lengths instead of frequencies
+const unsigned int MAGIC_NUMBER_CANONICAL = 0x48554632; // 'HUF2'
+// Block container: independently coded blocks, each with its own code lengths
+const unsigned int MAGIC_NUMBER_BLOCKS = 0x48554642; // 'HUFB'
+// Static table: the header names a registered dictionary instead of
+// carrying code lengths
+const unsigned int MAGIC_NUMBER_STATIC = 0x48554653; // 'HUFS'
+// Shuffled array: element size, then a block container of its byte planes
+const unsigned int MAGIC_NUMBER_SHUFFLED = 0x48554654; // 'HUFT'
+// Dictionary file: ID and code lengths (see trainDictionary)
+const unsigned int MAGIC_NUMBER_DICTIONARY = 0x48554644; // 'HUFD'
 
-// --- Node Utility ---
+// Block header: type (1 byte), raw size (4 bytes), payload size (4 bytes)
+#define BLOCK_HEADER_SIZE 9
+#define BLOCK_TYPE_END 0     // Marks the end of the blocks (sizes are 0)
+#define BLOCK_TYPE_HUFFMAN 1 // Code lengths followed by the bit stream
+#define BLOCK_TYPE_HUFFMAN4 2 // Code lengths, jump table, then four bit streams
+#define BLOCK_TYPE_STORED 3  // The raw bytes, for data Huffman coding cannot shrink
+#define BLOCK_TYPE_RLE 4     // One byte, repeated for the whole block
+#define STORED_ENTROPY_BITS 7.8 // Entropy (bits per byte) above which data is stored
+#define RAW_CONTAINER_MIN_SIZE 4096 // Smallest single-stream input worth a stored/RLE container
+#define JUMP_TABLE_SIZE 12    // Sizes of the first three streams (4 bytes each)
+#define INTERLEAVE_MIN_SIZE 1024 // Smaller blocks are always a single stream
+#define BLOCKS_PER_WORKER 4  // Blocks in flight per worker thread
+#define BLOCKS_START (STREAM_HEADER_SIZE + 4) // First block header, after the nominal block size
+// Char count of a streamed container, whose size is not known up front;
+// readers add up the block headers instead
+#define SIZE_UNKNOWN (~0ULL)
 
-Node* createNode(unsigned char data, unsigned long long freq) {
-    Node* temp = (Node*)malloc(sizeof(Node));
-    if (!temp) {
-        perror("malloc error (createNode)");
-        exit(EXIT_FAILURE);
-    }
-    temp->left = temp->right = NULL;
-    temp->data = data;
-    temp->freq = freq;
-    return temp;
+// Block index, written after the end marker: one entry per block, then a
+// footer that ends the file
+const unsigned int MAGIC_NUMBER_INDEX = 0x48554658; // 'HUFX'
+#define INDEX_ENTRY_SIZE 16  // Block offset (8), compressed size (4), raw size (4)
+#define INDEX_FOOTER_SIZE 20 // Index offset (8), block count (8), magic (4)
+
+// Decoder used by decompressFile (see setDecoderMode)
+static DecoderMode decoderMode = DECODER_TABLE;
+
+// Block container settings (see setBlockSize and setThreadCount)
+static size_t blockSize = 0; // 0 writes the single-stream canonical format
+static int threadCount = 0;  // 0 uses one worker per online CPU
+
+// Bit streams per block in block mode (see setStreamCount)
+static int streamCount = 1;
+
+// Longest code the encoder assigns (see setMaxCodeLength)
+static int maxCodeLength = HUFF_MAX_CODE_LENGTH;
+
+// Dictionary single streams are coded with (see setDictionary); 0 for none
+static unsigned dictionaryId = 0;
+
+// --- Statistics ---
+
+// Stats target of the calls made from this thread (see setStatsTarget).
+// Block workers fill their own HuffStats, merged by the calling thread.
+static _Thread_local HuffStats* statsTarget = NULL;
+
+void setStatsTarget(HuffStats* stats) {
+    statsTarget = stats;
 }
 
-// --- Min Heap Utilities ---
+HuffStats* getStatsTarget(void) {
+    return statsTarget;
+}
+
+const char* huffStageName(HuffStage stage) {
+    static const char* names[HUFF_STAGE_COUNT] = {"read", "histogram", "tree", "codes", "header", "bits", "write"};
+    return (stage >= 0 && stage < HUFF_STAGE_COUNT) ? names[stage] : "unknown";
+}
+
+// Wall-clock time in nanoseconds
+static unsigned long long nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
 
-MinHeap* createMinHeap(unsigned capacity) {
-    MinHeap* minHeap = (MinHeap*)malloc(sizeof(MinHeap));
-    if (!minHeap) {
-        perror("malloc error (createMinHeap)");
-        exit(EXIT_FAILURE);
+// Charges elapsed time to the stages of 'stats', if it is set. Time spent
+// in counted I/O meanwhile is already in the read and write stages, so it
+// is left out.
+typedef struct StageClock {
+    HuffStats* stats;
+    unsigned long long mark; // Time of the last lap
+    unsigned long long io;   // Read and write time at the last lap
+} StageClock;
+
+static void startClock(StageClock* clock, HuffStats* stats) {
+    clock->stats = stats;
+    if (!stats) return;
+    clock->mark = nowNs();
+    clock->io = stats->stageNs[HUFF_STAGE_READ] + stats->stageNs[HUFF_STAGE_WRITE];
+}
+
+// Charges the time since the last lap to 'stage'
+static void lapClock(StageClock* clock, HuffStage stage) {
+    HuffStats* stats = clock->stats;
+    if (!stats) return;
+    unsigned long long now = nowNs();
+    unsigned long long io = stats->stageNs[HUFF_STAGE_READ] + stats->stageNs[HUFF_STAGE_WRITE];
+    unsigned long long elapsed = now - clock->mark;
+    if (stage != HUFF_STAGE_READ && stage != HUFF_STAGE_WRITE) {
+        elapsed -= (io - clock->io < elapsed) ? io - clock->io : elapsed;
+    }
+    stats->stageNs[stage] += elapsed;
+    clock->mark = now;
+    clock->io = stats->stageNs[HUFF_STAGE_READ] + stats->stageNs[HUFF_STAGE_WRITE];
+}
+
+// Records one coded block (or single stream): its symbols, code lengths
+// (NULL for stored and RLE blocks) and, for compression, the entropy of
+// its histogram
+static void recordBlockStats(HuffStats* stats, const unsigned long long freqTable[NUM_CHARS],
+                             const unsigned char lengths[NUM_CHARS], unsigned long long symbols,
+                             unsigned long long codedBits) {
+    if (!stats) return;
+    unsigned distinct = 0, depth = 0;
+    for (int i = 0; i < NUM_CHARS; ++i) {
+        if (lengths ? lengths[i] == 0 : !(freqTable && freqTable[i])) continue;
+        distinct++;
+        if (lengths && lengths[i] > depth) depth = lengths[i];
+        if (freqTable && freqTable[i]) {
+            stats->entropyBits += freqTable[i] * log2((double)symbols / freqTable[i]);
+        }
     }
-    minHeap->size = 0;
-    minHeap->capacity = capacity;
-    minHeap->array = (MinHeapNode**)malloc(capacity * sizeof(MinHeapNode*));
-    if (!minHeap->array) {
-        perror("malloc error (minHeap->array)");
-        exit(EXIT_FAILURE);
+    stats->blocks++;
+    stats->symbols += symbols;
+    stats->codedBits += codedBits;
+    if (distinct > stats->distinctSymbols) stats->distinctSymbols = distinct;
+    if (depth > stats->treeDepth) stats->treeDepth = depth;
+}
+
+// Adds the stats of a block worker to 'into'
+static void mergeStats(HuffStats* into, const HuffStats* from) {
+    for (int s = 0; s < HUFF_STAGE_COUNT; ++s) into->stageNs[s] += from->stageNs[s];
+    into->blocks += from->blocks;
+    into->symbols += from->symbols;
+    into->codedBits += from->codedBits;
+    into->entropyBits += from->entropyBits;
+    if (from->distinctSymbols > into->distinctSymbols) into->distinctSymbols = from->distinctSymbols;
+    if (from->treeDepth > into->treeDepth) into->treeDepth = from->treeDepth;
+}
+
+// Clears the stats target for a new call (compress: 1 or 0)
+static void beginStats(int compress) {
+    if (!statsTarget) return;
+    memset(statsTarget, 0, sizeof(*statsTarget));
+    statsTarget->compress = compress;
+    statsTarget->totalNs = nowNs(); // The start, until endStats
+}
+
+// Finishes the stats of a call that read 'bytesIn' and wrote 'bytesOut'
+static void endStats(unsigned long long bytesIn, unsigned long long bytesOut) {
+    HuffStats* stats = statsTarget;
+    if (!stats) return;
+    stats->totalNs = nowNs() - stats->totalNs;
+    stats->bytesIn = bytesIn;
+    stats->bytesOut = bytesOut;
+    if (stats->symbols > 0) {
+        stats->averageCodeLength = (double)stats->codedBits / stats->symbols;
+        stats->entropy = stats->entropyBits / stats->symbols;
     }
-    return minHeap;
 }
 
-void swapMinHeapNode(MinHeapNode** a, MinHeapNode** b) {
-    MinHeapNode* t = *a;
+// fread and fwrite of whole buffers, counted and timed in the stats of
+// the calling thread
+static size_t readBuffer(void* dest, size_t n, FILE* in) {
+    if (!statsTarget) return fread(dest, 1, n, in);
+    unsigned long long start = nowNs();
+    size_t got = fread(dest, 1, n, in);
+    statsTarget->stageNs[HUFF_STAGE_READ] += nowNs() - start;
+    statsTarget->readCalls++;
+    statsTarget->bytesIn += got;
+    return got;
+}
+
+static size_t writeBuffer(const void* src, size_t n, FILE* out) {
+    if (!statsTarget) return fwrite(src, 1, n, out);
+    unsigned long long start = nowNs();
+    size_t put = fwrite(src, 1, n, out);
+    statsTarget->stageNs[HUFF_STAGE_WRITE] += nowNs() - start;
+    statsTarget->writeCalls++;
+    statsTarget->bytesOut += put;
+    return put;
+}
+
+// --- Node Utility ---
+
+void initTree(HuffTree* tree) {
+    tree->count = 0;
+    tree->root = HUFF_TREE_NONE;
+}
+
+unsigned short createNode(HuffTree* tree, unsigned char data, unsigned long long freq) {
+    if (tree->count == HUFF_TREE_MAX_NODES) return HUFF_TREE_NONE;
+    Node* node = &tree->nodes[tree->count];
+    node->left = node->right = HUFF_TREE_NONE;
+    node->data = data;
+    node->freq = freq;
+    return tree->count++;
+}
+
+// --- Min Heap Utilities ---
+
+// Frequency of the node at heap position i
+static inline unsigned long long heapFreq(const HuffTree* tree, const MinHeap* minHeap, unsigned i) {
+    return tree->nodes[minHeap->array[i]].freq;
+}
+
+void swapMinHeapNode(unsigned short* a, unsigned short* b) {
+    unsigned short t = *a;
     *a = *b;
     *b = t;
 }
 
-void minHeapify(MinHeap* minHeap, int idx) {
-    int smallest = idx;
-    int left = 2 * idx + 1;
-    int right = 2 * idx + 2;
+void minHeapify(const HuffTree* tree, MinHeap* minHeap, unsigned idx) {
+    for (;;) {
+        unsigned smallest = idx;
+        unsigned left = 2 * idx + 1;
+        unsigned right = 2 * idx + 2;
 
-    if (left < minHeap->size && minHeap->array[left]->huffmanNode->freq < minHeap->array[smallest]->huffmanNode->freq)
-        smallest = left;
+        if (left < minHeap->size && heapFreq(tree, minHeap, left) < heapFreq(tree, minHeap, smallest))
+            smallest = left;
 
-    if (right < minHeap->size && minHeap->array[right]->huffmanNode->freq < minHeap->array[smallest]->huffmanNode->freq)
-        smallest = right;
+        if (right < minHeap->size && heapFreq(tree, minHeap, right) < heapFreq(tree, minHeap, smallest))
+            smallest = right;
 
-    if (smallest != idx) {
+        if (smallest == idx) return;
         swapMinHeapNode(&minHeap->array[smallest], &minHeap->array[idx]);
-        minHeapify(minHeap, smallest);
+        idx = smallest;
     }
 }
 
-int isMinHeapSizeOne(MinHeap* minHeap) {
+int isMinHeapSizeOne(const MinHeap* minHeap) {
     return (minHeap->size == 1);
 }
 
-Node* extractMin(MinHeap* minHeap) {
-    if (minHeap->size == 0) return NULL;
+unsigned short extractMin(const HuffTree* tree, MinHeap* minHeap) {
+    if (minHeap->size == 0) return HUFF_TREE_NONE;
 
-    MinHeapNode* temp = minHeap->array[0];
+    unsigned short node = minHeap->array[0];
     minHeap->array[0] = minHeap->array[minHeap->size - 1];
     --minHeap->size;
-    minHeapify(minHeap, 0);
-
-    Node* huffmanNode = temp->huffmanNode;
-    free(temp); // Free the heap node wrapper, not the huffman node
-    return huffmanNode;
+    minHeapify(tree, minHeap, 0);
+    return node;
 }
 
-void insertMinHeap(MinHeap* minHeap, Node* huffmanNode) {
-    if (minHeap->size == minHeap->capacity) {
+void insertMinHeap(const HuffTree* tree, MinHeap* minHeap, unsigned short node) {
+    if (minHeap->size == NUM_CHARS) {
         // This shouldn't happen with our logic, but it's good practice
         fprintf(stderr, "Heap is full. Cannot insert.\n");
         return;
     }
 
-    MinHeapNode* minHeapNode = (MinHeapNode*)malloc(sizeof(MinHeapNode));
-    minHeapNode->huffmanNode = huffmanNode;
-
-    ++minHeap->size;
-    int i = minHeap->size - 1;
-    minHeap->array[i] = minHeapNode;
+    unsigned i = minHeap->size++;
+    minHeap->array[i] = node;
 
     // Fix the min heap property
-    while (i && minHeap->array[i]->huffmanNode->freq < minHeap->array[(i - 1) / 2]->huffmanNode->freq) {
+    while (i && heapFreq(tree, minHeap, i) < heapFreq(tree, minHeap, (i - 1) / 2)) {
         swapMinHeapNode(&minHeap->array[i], &minHeap->array[(i - 1) / 2]);
         i = (i - 1) / 2;
     }
 }
 
-void buildMinHeap(MinHeap* minHeap) {
-    int n = minHeap->size - 1;
+void buildMinHeap(const HuffTree* tree, MinHeap* minHeap) {
+    int n = (int)minHeap->size - 1;
     for (int i = (n - 1) / 2; i >= 0; --i)
-        minHeapify(minHeap, i);
+        minHeapify(tree, minHeap, (unsigned)i);
 }
 
 // --- Huffman Tree Utilities ---
 
-int isLeaf(Node* root) {
-    return !(root->left) && !(root->right);
+int isLeaf(const Node* node) {
+    return node->left == HUFF_TREE_NONE && node->right == HUFF_TREE_NONE;
 }
 
-Node* buildHuffmanTree(unsigned long long freqTable[]) {
-    MinHeap* minHeap = createMinHeap(NUM_CHARS);
-    int charCount = 0;
+int buildHuffmanTree(const unsigned long long freqTable[], HuffTree* tree) {
+    MinHeap minHeap;
+    minHeap.size = 0;
+    initTree(tree);
 
     // Create a leaf node for each character with non-zero frequency
     // and add it to the min heap.
     for (int i = 0; i < NUM_CHARS; ++i) {
         if (freqTable[i] > 0) {
-            Node* node = createNode((unsigned char)i, freqTable[i]);
-            MinHeapNode* minHeapNode = (MinHeapNode*)malloc(sizeof(MinHeapNode));
-            minHeapNode->huffmanNode = node;
-            minHeap->array[charCount] = minHeapNode;
-            charCount++;
+            minHeap.array[minHeap.size++] = createNode(tree, (unsigned char)i, freqTable[i]);
         }
     }
-    minHeap->size = charCount;
-    
+
     // Handle edge case: empty file
-    if (minHeap->size == 0) {
-        free(minHeap->array);
-        free(minHeap);
-        return NULL; // Or a special node
-    }
-    
+    if (minHeap.size == 0) return -1;
+
     // Handle edge case: file with only one unique character
-    if (minHeap->size == 1) {
-        Node* root = extractMin(minHeap);
+    if (minHeap.size == 1) {
         // Create a dummy parent node
-        Node* parent = createNode('$', root->freq); 
-        parent->left = root;
-        insertMinHeap(minHeap, parent);
-    } else {
-        buildMinHeap(minHeap);
+        unsigned short leaf = minHeap.array[0];
+        unsigned short parent = createNode(tree, '$', tree->nodes[leaf].freq);
+        tree->nodes[parent].left = leaf;
+        tree->root = parent;
+        return 0;
     }
-
+    buildMinHeap(tree, &minHeap);
 
     // Iterate while size of heap doesn't become 1
-    while (!isMinHeapSizeOne(minHeap)) {
+    while (!isMinHeapSizeOne(&minHeap)) {
         // Extract the two minimum freq items from min heap
-        Node* left = extractMin(minHeap);
-        Node* right = extractMin(minHeap);
+        unsigned short left = extractMin(tree, &minHeap);
+        unsigned short right = extractMin(tree, &minHeap);
 
         // Create a new internal node with freq = sum of two nodes' freq.
         // Use a non-character value ($) for internal nodes.
-        Node* top = createNode('$', left->freq + right->freq);
-        top->left = left;
-        top->right = right;
+        unsigned short top = createNode(tree, '$', tree->nodes[left].freq + tree->nodes[right].freq);
+        tree->nodes[top].left = left;
+        tree->nodes[top].right = right;
 
-        insertMinHeap(minHeap, top);
+        insertMinHeap(tree, &minHeap, top);
     }
 
     // The remaining node is the root node
-    Node* root = extractMin(minHeap);
-    
-    // Free the heap structure
-    free(minHeap->array);
-    free(minHeap);
-
-    return root;
-}
-
-void freeTree(Node* root) {
-    if (root == NULL) return;
-    freeTree(root->left);
-    freeTree(root->right);
-    free(root);
+    tree->root = extractMin(tree, &minHeap);
+    return 0;
 }
 
 // --- Code Generation ---
 
-// Fills codeMap with '0' and '1' strings representing the codes
-void generateCodes(Node* root, char* codeMap[NUM_CHARS], char buffer[], int top) {
-    if (root == NULL) return;
+// Fills codeMap with '0' and '1' strings representing the codes.
+// Returns 0, or -1 if a string could not be allocated.
+int generateCodes(const HuffTree* tree, unsigned short node, char* codeMap[NUM_CHARS], char buffer[], int top) {
+    if (node == HUFF_TREE_NONE) return 0;
+    const Node* n = &tree->nodes[node];
 
     // If this is a left child, add '0' to buffer
-    if (root->left) {
+    if (n->left != HUFF_TREE_NONE) {
         buffer[top] = '0';
-        generateCodes(root->left, codeMap, buffer, top + 1);
+        if (generateCodes(tree, n->left, codeMap, buffer, top + 1) != 0) return -1;
     }
 
     // If this is a right child, add '1' to buffer
-    if (root->right) {
+    if (n->right != HUFF_TREE_NONE) {
         buffer[top] = '1';
-        generateCodes(root->right, codeMap, buffer, top + 1);
+        if (generateCodes(tree, n->right, codeMap, buffer, top + 1) != 0) return -1;
     }
 
     // If this is a leaf node, it contains a character
-    if (isLeaf(root)) {
+    if (isLeaf(n)) {
         buffer[top] = '\0'; // Null-terminate the string
-        codeMap[root->data] = (char*)malloc(strlen(buffer) + 1);
-        if(!codeMap[root->data]) {
+        codeMap[n->data] = (char*)malloc(strlen(buffer) + 1);
+        if(!codeMap[n->data]) {
             perror("malloc error (codeMap)");
-            exit(EXIT_FAILURE);
+            return -1;
         }
-        strcpy(codeMap[root->data], buffer);
+        strcpy(codeMap[n->data], buffer);
     }
+    return 0;
 }
 
-// --- Main File I/O Functions ---
+// Fills codes[] with integer codes for the encoder.
+// Lengths are bounded by the tree depth, which stays far below 64 for any
+// input smaller than ~10^13 bytes (a Fibonacci-shaped tree is the worst case).
+// Returns 0, or -1 if a code is longer than that anyway.
+int generateCodeTable(const HuffTree* tree, unsigned short node, HuffCode codes[NUM_CHARS],
+                      unsigned long long code, int length) {
+    if (node == HUFF_TREE_NONE) return 0;
+    const Node* n = &tree->nodes[node];
 
-void compressFile(const char* inputPath, const char* outputPath) {
-    FILE *in = fopen(inputPath, "rb"); // Read in binary mode
-    if (!in) {
-        perror("Failed to open input file");
-        return;
+    if (isLeaf(n)) {
+        if (length > 64) {
+            fprintf(stderr, "Error: Huffman code longer than 64 bits.\n");
+            return -1;
+        }
+        codes[n->data].bits = code;
+        codes[n->data].length = (unsigned char)length;
+        return 0;
     }
 
-    // 1. Count frequencies
-    unsigned long long freqTable[NUM_CHARS] = {0};
-    unsigned long long originalCharCount = 0;
-    int c;
-    while ((c = fgetc(in)) != EOF) {
-        freqTable[c]++;
-        originalCharCount++;
+    if (generateCodeTable(tree, n->left, codes, code << 1, length + 1) != 0) return -1;
+    return generateCodeTable(tree, n->right, codes, (code << 1) | 1, length + 1);
+}
+
+// --- Canonical Codes ---
+
+// Sort key of a used symbol: frequency above, symbol in the low byte, so
+// equal frequencies order by symbol and the result is deterministic.
+// Frequencies are clamped to 56 bits (64 PiB of one byte value).
+#define FREQ_KEY_MAX ((1ull << 56) - 1)
+
+// Sorts keys[0..n) ascending: LSD radix sort, one byte per pass, skipping
+// the passes where every key has the same digit (usually the high bytes)
+static void sortFrequencyKeys(unsigned long long* keys, int n) {
+    unsigned long long scratch[NUM_CHARS];
+    unsigned long long* src = keys;
+    unsigned long long* dst = scratch;
+    for (int shift = 0; shift < 64; shift += 8) {
+        int count[NUM_CHARS] = {0};
+        for (int i = 0; i < n; ++i) count[(src[i] >> shift) & 0xFF]++;
+        if (count[(src[0] >> shift) & 0xFF] == n) continue;
+        int start = 0;
+        for (int d = 0; d < NUM_CHARS; ++d) {
+            int c = count[d];
+            count[d] = start;
+            start += c;
+        }
+        for (int i = 0; i < n; ++i) dst[count[(src[i] >> shift) & 0xFF]++] = src[i];
+        unsigned long long* t = src;
+        src = dst;
+        dst = t;
     }
-    
-    // Handle empty file
-    if (originalCharCount == 0) {
-        fclose(in);
-        // Create an empty output file
-        FILE *out = fopen(outputPath, "wb");
-        if(out) fclose(out);
-        printf("Input file is empty. Created empty output file.\n");
+    if (src != keys) memcpy(keys, src, n * sizeof(*keys));
+}
+
+// In-place minimum-redundancy code lengths (Moffat & Katajainen, 1995).
+// On entry a[0..n) holds frequencies in ascending order; on return a[i] is
+// the code length of item i. Three linear passes replace the tree: the
+// first pairs leaves and internal nodes as a two-queue merge, storing
+// parent links in a[], the second turns parent links into internal node
+// depths, and the third hands the depths out to the leaves.
+static void minimumRedundancyLengths(unsigned long long* a, int n) {
+    if (n == 1) {
+        a[0] = 1; // a lone symbol still needs one bit
         return;
     }
+    // 1. Left to right: combine the two lightest of the next leaf and the next internal node
+    int root = 0, leaf = 2;
+    a[0] += a[1];
+    for (int next = 1; next < n - 1; ++next) {
+        if (leaf >= n || a[root] < a[leaf]) {
+            a[next] = a[root];
+            a[root++] = next;
+        } else {
+            a[next] = a[leaf++];
+        }
+        if (leaf >= n || (root < next && a[root] < a[leaf])) {
+            a[next] += a[root];
+            a[root++] = next;
+        } else {
+            a[next] += a[leaf++];
+        }
+    }
 
-    // 2. Build the Huffman Tree
-    Node* root = buildHuffmanTree(freqTable);
-
-    // 3. Generate codes
-    char* codeMap[NUM_CHARS] = {0}; // Array of string pointers
-    char buffer[MAX_TREE_HT];
-    generateCodes(root, codeMap, buffer, 0);
+    // 2. Right to left: parent links become internal node depths
+    a[n - 2] = 0;
+    for (int next = n - 3; next >= 0; --next) a[next] = a[a[next]] + 1;
 
-    // 4. Open output file for writing (binary mode)
-    FILE *out = fopen(outputPath, "wb");
-    if (!out) {
-        perror("Failed to open output file");
-        fclose(in);
-        return;
+    // 3. Right to left: every level's free slots go to leaves
+    int available = 1, used = 0, next = n - 1;
+    unsigned long long depth = 0;
+    root = n - 2;
+    while (available > 0) {
+        while (root >= 0 && a[root] == depth) {
+            used++;
+            root--;
+        }
+        while (available > used) {
+            a[next--] = depth;
+            available--;
+        }
+        available = 2 * used;
+        depth++;
+        used = 0;
     }
+}
 
-    // 5. Write the "header"
-    //    a. Magic number
-    fwrite(&MAGIC_NUMBER, sizeof(unsigned int), 1, out);
-    //    b. Original character count (for decompression)
-    fwrite(&originalCharCount, sizeof(unsigned long long), 1, out);
-    //    c. The frequency table (this is how we rebuild the tree)
-    fwrite(freqTable, sizeof(unsigned long long), NUM_CHARS, out);
-
-    // 6. Re-read input file and write compressed bits
-    fseek(in, 0, SEEK_SET); // Go back to start of input file
-
-    unsigned char bitBuffer = 0;
-    int bitCount = 0;
-
-    while ((c = fgetc(in)) != EOF) {
-        char* code = codeMap[c];
-        for (int i = 0; code[i] != '\0'; ++i) {
-            // Add the bit to our buffer
-            if (code[i] == '1') {
-                bitBuffer |= (1 << (7 - bitCount));
-            }
-            bitCount++;
+// Optimal code lengths of at most 'maxLength' bits (package-merge,
+// Larmore & Hirschberg). 'keys' are the sort keys of the n used symbols in
+// ascending order; n must not exceed 2^maxLength.
+// Every level's list merges the symbols with the pairs ("packages") of the
+// level below it. Of the last list, the first 2n - 2 items are the
+// cheapest set of coins that fills the Kraft sum, and each symbol's code
+// length is the number of levels at which it is among the chosen items.
+// Since symbols and packages both stay sorted, the chosen items at a level
+// are a prefix of its list: the lightest symbols, and the packages that
+// select a prefix of the level below. Only the package flags are kept.
+static void packageMergeLengths(const unsigned long long keys[], int n, int maxLength,
+                                unsigned char lengths[NUM_CHARS]) {
+    unsigned long long weights[2][2 * NUM_CHARS];
+    unsigned char isPackage[HUFF_MAX_CODE_LENGTH][2 * NUM_CHARS];
+    int listSize[HUFF_MAX_CODE_LENGTH];
 
-            // If buffer is full (8 bits), write it to file
-            if (bitCount == 8) {
-                fwrite(&bitBuffer, sizeof(unsigned char), 1, out);
-                bitBuffer = 0;
-                bitCount = 0;
+    // 1. Build the lists, deepest level first
+    for (int i = 0; i < n; ++i) {
+        weights[0][i] = keys[i] >> 8;
+        isPackage[0][i] = 0;
+    }
+    listSize[0] = n;
+    for (int level = 1; level < maxLength; ++level) {
+        const unsigned long long* below = weights[(level - 1) & 1];
+        unsigned long long* list = weights[level & 1];
+        int packages = listSize[level - 1] / 2;
+        int p = 0, leaf = 0, k = 0;
+        while (p < packages || leaf < n) {
+            unsigned long long leafWeight = leaf < n ? keys[leaf] >> 8 : 0;
+            if (leaf < n && (p == packages || leafWeight <= below[2 * p] + below[2 * p + 1])) {
+                list[k] = leafWeight;
+                isPackage[level][k++] = 0;
+                leaf++;
+            } else {
+                list[k] = below[2 * p] + below[2 * p + 1];
+                isPackage[level][k++] = 1;
+                p++;
             }
         }
+        listSize[level] = k;
     }
 
-    // Write any remaining bits (padding)
-    if (bitCount > 0) {
-        fwrite(&bitBuffer, sizeof(unsigned char), 1, out);
+    // 2. Walk back down, counting how often each symbol is chosen
+    int depth[NUM_CHARS] = {0};
+    int take = 2 * n - 2;
+    for (int level = maxLength - 1; level >= 0; --level) {
+        int packages = 0;
+        for (int k = 0; k < take; ++k) packages += isPackage[level][k];
+        for (int i = 0; i < take - packages; ++i) depth[i]++;
+        take = 2 * packages;
     }
+    for (int i = 0; i < n; ++i) lengths[keys[i] & 0xFF] = (unsigned char)depth[i];
+}
 
-    // 7. Clean up
-    fclose(in);
-    fclose(out);
-    freeTree(root);
+void computeCodeLengths(const unsigned long long freqTable[NUM_CHARS], unsigned char lengths[NUM_CHARS],
+                        int maxLength) {
+    memset(lengths, 0, NUM_CHARS);
+
+    // 1. Sort the used symbols by frequency, once
+    unsigned long long keys[NUM_CHARS];
+    int n = 0;
     for (int i = 0; i < NUM_CHARS; ++i) {
-        if (codeMap[i]) free(codeMap[i]);
+        if (freqTable[i] == 0) continue;
+        unsigned long long f = freqTable[i] > FREQ_KEY_MAX ? FREQ_KEY_MAX : freqTable[i];
+        keys[n++] = (f << 8) | (unsigned long long)i;
     }
+    if (n == 0) return;
+    sortFrequencyKeys(keys, n);
 
-    printf("Compression successful.\n");
+    // 2. Code lengths in place, no tree needed
+    unsigned long long work[NUM_CHARS];
+    for (int i = 0; i < n; ++i) work[i] = keys[i] >> 8;
+    minimumRedundancyLengths(work, n);
+    for (int i = 0; i < n; ++i) lengths[keys[i] & 0xFF] = (unsigned char)work[i];
+    int maxDepth = (int)work[0];
+    if (maxDepth <= maxLength) return;
+
+    // Too deep: redo the lengths optimally under the limit
+    packageMergeLengths(keys, n, maxLength, lengths);
 }
 
-void decompressFile(const char* inputPath, const char* outputPath) {
-    FILE *in = fopen(inputPath, "rb");
-    if (!in) {
-        perror("Failed to open input file");
-        return;
+// Canonical code assignment (as in DEFLATE): codes of the same length are
+// consecutive in symbol order, and shorter codes sort before longer ones.
+void assignCanonicalCodes(const unsigned char lengths[NUM_CHARS], HuffCode codes[NUM_CHARS]) {
+    int perLength[MAX_TREE_HT] = {0};
+    for (int i = 0; i < NUM_CHARS; ++i) {
+        perLength[lengths[i]]++;
     }
+    perLength[0] = 0;
 
-    // 1. Read and verify magic number
-    unsigned int magic;
-    if (fread(&magic, sizeof(unsigned int), 1, in) != 1 || magic != MAGIC_NUMBER) {
-        fprintf(stderr, "Error: Not a valid .huff file or file is corrupted.\n");
-        fclose(in);
-        return;
+    unsigned long long nextCode[MAX_TREE_HT];
+    unsigned long long code = 0;
+    for (int len = 1; len < MAX_TREE_HT; ++len) {
+        code = (code + perLength[len - 1]) << 1;
+        nextCode[len] = code;
     }
 
-    // 2. Read original char count and frequency table
-    unsigned long long originalCharCount;
-    unsigned long long freqTable[NUM_CHARS];
-    
-    if (fread(&originalCharCount, sizeof(unsigned long long), 1, in) != 1) {
-         fprintf(stderr, "Error: Failed to read header.\n");
-         fclose(in);
-         return;
+    for (int i = 0; i < NUM_CHARS; ++i) {
+        codes[i].length = lengths[i];
+        codes[i].bits = lengths[i] ? nextCode[lengths[i]]++ : 0;
     }
-    
-    // Handle empty file
-    if (originalCharCount == 0) {
-        fclose(in);
-        FILE *out = fopen(outputPath, "wb"); // Create empty file
-        if (out) fclose(out);
-        printf("Decompression successful (empty file).\n");
-        return;
+}
+
+int buildCanonicalTree(const HuffCode codes[NUM_CHARS], HuffTree* tree) {
+    initTree(tree);
+    tree->root = createNode(tree, '$', 0);
+    for (int i = 0; i < NUM_CHARS; ++i) {
+        unsigned short node = tree->root;
+        for (int b = codes[i].length - 1; b >= 0; --b) {
+            unsigned short* child = ((codes[i].bits >> b) & 1) ? &tree->nodes[node].right : &tree->nodes[node].left;
+            if (*child == HUFF_TREE_NONE) {
+                // Only incomplete codes need more than HUFF_TREE_MAX_NODES
+                if ((*child = createNode(tree, '$', 0)) == HUFF_TREE_NONE) return -1;
+            }
+            node = *child;
+        }
+        if (node != tree->root) tree->nodes[node].data = (unsigned char)i;
     }
+    return 0;
+}
 
-    if (fread(freqTable, sizeof(unsigned long long), NUM_CHARS, in) != NUM_CHARS) {
-        fprintf(stderr, "Error: Failed to read frequency table.\n");
-        fclose(in);
-        return;
+// Picks the cheapest way to code 'size' bytes with this histogram before
+// any tree is built: BLOCK_TYPE_RLE for one repeated byte,
+// BLOCK_TYPE_STORED when the entropy says Huffman coding would save next
+// to nothing (compressed media), BLOCK_TYPE_HUFFMAN otherwise.
+static int chooseBlockType(const unsigned long long freqTable[NUM_CHARS], size_t size) {
+    if (size == 0) return BLOCK_TYPE_HUFFMAN;
+    int distinct = 0;
+    double bits = 0;
+    for (int i = 0; i < NUM_CHARS; ++i) {
+        if (freqTable[i] == 0) continue;
+        distinct++;
+        bits += freqTable[i] * log2((double)size / freqTable[i]);
     }
+    if (distinct == 1) return BLOCK_TYPE_RLE;
+    return (bits >= STORED_ENTROPY_BITS * size) ? BLOCK_TYPE_STORED : BLOCK_TYPE_HUFFMAN;
+}
 
-    // 3. Rebuild the Huffman Tree
-    Node* root = buildHuffmanTree(freqTable);
-    if (!root) {
-        fprintf(stderr, "Error: Failed to rebuild Huffman tree.\n");
-        fclose(in);
-        return;
+// Builds the encoder's codes for a histogram, charging the time to the
+// tree and codes stages of 'clock'. Returns the exact size of the coded
+// data in bits.
+static unsigned long long buildEncoderCodes(const unsigned long long freqTable[NUM_CHARS],
+                                            unsigned char lengths[NUM_CHARS], HuffCode codes[NUM_CHARS],
+                                            StageClock* clock) {
+    computeCodeLengths(freqTable, lengths, maxCodeLength);
+    lapClock(clock, HUFF_STAGE_TREE);
+    unsigned long long bits = 0;
+    for (int i = 0; i < NUM_CHARS; ++i) bits += freqTable[i] * lengths[i];
+    assignCanonicalCodes(lengths, codes);
+    lapClock(clock, HUFF_STAGE_CODES);
+    return bits;
+}
+
+// Code length header: first and last used symbol, then one nibble per
+// symbol in that range (high nibble first). Returns the bytes written to
+// 'dest' (at most CODE_LENGTHS_MAX_SIZE).
+static size_t packCodeLengths(const unsigned char lengths[NUM_CHARS], unsigned char* dest) {
+    int first = 0, last = NUM_CHARS - 1;
+    while (first < last && lengths[first] == 0) first++;
+    while (last > first && lengths[last] == 0) last--;
+
+    size_t n = 0;
+    dest[n++] = (unsigned char)first;
+    dest[n++] = (unsigned char)last;
+    for (int i = first; i <= last; i += 2) {
+        unsigned char hi = lengths[i];
+        unsigned char lo = (i + 1 <= last) ? lengths[i + 1] : 0;
+        dest[n++] = (unsigned char)((hi << 4) | lo);
     }
+    return n;
+}
 
-    // 4. Open output file
-    FILE *out = fopen(outputPath, "wb");
-    if (!out) {
-        perror("Failed to open output file");
-        fclose(in);
-        freeTree(root);
-        return;
+// Parses a code length header from src[0..size). Returns the bytes
+// consumed, or 0 if the header is truncated or the lengths do not
+// describe a valid prefix code.
+static size_t unpackCodeLengths(const unsigned char* src, size_t size, unsigned char lengths[NUM_CHARS]) {
+    if (size < 2 || src[0] > src[1]) return 0;
+    int first = src[0], last = src[1];
+    size_t n = 2 + (size_t)(last - first + 2) / 2;
+    if (size < n) return 0;
+
+    memset(lengths, 0, NUM_CHARS);
+    const unsigned char* p = src + 2;
+    for (int i = first; i <= last; i += 2) {
+        lengths[i] = (unsigned char)(*p >> 4);
+        if (i + 1 <= last) lengths[i + 1] = (unsigned char)(*p & 0x0F);
+        p++;
+    }
+
+    // Kraft inequality: the codes must not overlap
+    unsigned long long kraft = 0;
+    for (int i = 0; i < NUM_CHARS; ++i) {
+        if (lengths[i]) kraft += 1ull << (HUFF_MAX_CODE_LENGTH - lengths[i]);
     }
+    if (kraft == 0 || kraft > (1ull << HUFF_MAX_CODE_LENGTH)) return 0;
+    return n;
+}
 
-    // 5. Read compressed data bit by bit and write to output
-    Node* currentNode = root;
-    unsigned char bitBuffer;
-    int bitCount = 0;
-    unsigned long long charsWritten = 0;
+// Returns 0 on success, -1 if the header is truncated or invalid.
+static int readCodeLengths(FILE* in, unsigned char lengths[NUM_CHARS]) {
+    unsigned char packed[CODE_LENGTHS_MAX_SIZE];
+    if (fread(packed, 1, 2, in) != 2 || packed[0] > packed[1]) return -1;
+    size_t rest = (size_t)(packed[1] - packed[0] + 2) / 2;
+    if (fread(packed + 2, 1, rest, in) != rest) return -1;
+    return unpackCodeLengths(packed, 2 + rest, lengths) ? 0 : -1;
+}
 
-    while (charsWritten < originalCharCount && fread(&bitBuffer, sizeof(unsigned char), 1, in) == 1) {
-        bitCount = 0;
-        while (charsWritten < originalCharCount && bitCount < 8) {
-            // Check the current bit
-            if ((bitBuffer >> (7 - bitCount)) & 1) {
-                currentNode = currentNode->right;
-            } else {
-                currentNode = currentNode->left;
-            }
-            bitCount++;
+// --- Dictionaries ---
 
-            if (isLeaf(currentNode)) {
-                fputc(currentNode->data, out);
-                charsWritten++;
-                currentNode = root; // Go back to the root for the next char
-            }
-        }
+// A registered dictionary: a code trained on sample data, referenced by ID
+// from the header of a static-table stream instead of being stored in it
+typedef struct Dictionary {
+    unsigned id;
+    unsigned char lengths[NUM_CHARS];
+    HuffCode codes[NUM_CHARS];
+} Dictionary;
+
+static Dictionary dictionaries[HUFF_MAX_DICTIONARIES];
+static int dictionaryCount = 0;
+static pthread_mutex_t dictionaryLock = PTHREAD_MUTEX_INITIALIZER;
+
+int registerDictionary(unsigned id, const unsigned char lengths[NUM_CHARS]) {
+    if (id == 0) return -1;
+
+    // Same check as a code length header: the codes must not overlap
+    unsigned long long kraft = 0;
+    for (int i = 0; i < NUM_CHARS; ++i) {
+        if (lengths[i] > HUFF_MAX_CODE_LENGTH) return -1;
+        if (lengths[i]) kraft += 1ull << (HUFF_MAX_CODE_LENGTH - lengths[i]);
     }
+    if (kraft == 0 || kraft > (1ull << HUFF_MAX_CODE_LENGTH)) return -1;
 
-    // 6. Clean up
-    fclose(in);
-    fclose(out);
-    freeTree(root);
+    pthread_mutex_lock(&dictionaryLock);
+    int slot = 0;
+    while (slot < dictionaryCount && dictionaries[slot].id != id) slot++;
+    if (slot == HUFF_MAX_DICTIONARIES) {
+        pthread_mutex_unlock(&dictionaryLock);
+        return -1;
+    }
+    if (slot == dictionaryCount) dictionaryCount++;
+    dictionaries[slot].id = id;
+    memcpy(dictionaries[slot].lengths, lengths, NUM_CHARS);
+    assignCanonicalCodes(lengths, dictionaries[slot].codes);
+    pthread_mutex_unlock(&dictionaryLock);
+    return 0;
+}
 
-    printf("Decompression successful.\n");
+// Copies the lengths and codes (either may be NULL) of dictionary 'id'.
+// Returns 0, or -1 if no dictionary has that ID.
+static int findDictionary(unsigned id, unsigned char lengths[NUM_CHARS], HuffCode codes[NUM_CHARS]) {
+    int found = -1;
+    pthread_mutex_lock(&dictionaryLock);
+    for (int i = 0; i < dictionaryCount; ++i) {
+        if (dictionaries[i].id != id) continue;
+        if (lengths) memcpy(lengths, dictionaries[i].lengths, NUM_CHARS);
+        if (codes) memcpy(codes, dictionaries[i].codes, sizeof(dictionaries[i].codes));
+        found = 0;
+        break;
+    }
+    pthread_mutex_unlock(&dictionaryLock);
+    return found;
 }
 
+int hasDictionary(unsigned id) {
+    return findDictionary(id, NULL, NULL) == 0;
+}
 
-// --- Public API Functions (for Python ctypes) ---
+void clearDictionaries(void) {
+    pthread_mutex_lock(&dictionaryLock);
+    dictionaryCount = 0;
+    pthread_mutex_unlock(&dictionaryLock);
+    dictionaryId = 0;
+}
 
-int api_compress_file(const char* inputPath, const char* outputPath) {
-    // A real implementation would have try/catch or better error checking.
-    // For C, we check file pointers and return -1 on failure.
-    
-    // We can't really "catch" a malloc fail, as we exit(), but we can check
-    // file I/O. For this project, we'll keep it simple.
-    
-    FILE *in = fopen(inputPath, "rb");
-    if (!in) {
-        perror("API: Failed to open input file");
-        return -1;
+// Builds a dictionary from the byte counts of a sample corpus, saves it to
+// outputPath and registers it. Returns its ID, or -1 on error.
+static long long saveTrainedDictionary(const unsigned long long freqTable[NUM_CHARS], unsigned id,
+                                       const char* outputPath) {
+    // 1. Every byte value gets a code, so any message can use the
+    //    dictionary, however far it strays from the samples
+    unsigned long long counts[NUM_CHARS];
+    for (int i = 0; i < NUM_CHARS; ++i) counts[i] = freqTable[i] + 1;
+    unsigned char lengths[NUM_CHARS];
+    computeCodeLengths(counts, lengths, maxCodeLength);
+
+    // 2. ID 0 derives one from the code (FNV-1a), so the same samples
+    //    always give the same ID
+    if (id == 0) {
+        unsigned hash = 2166136261u;
+        for (int i = 0; i < NUM_CHARS; ++i) hash = (hash ^ lengths[i]) * 16777619u;
+        id = hash ? hash : 1;
     }
-    fclose(in); // We only checked if it exists, compressFile will reopen
 
-    compressFile(inputPath, outputPath);
-    
-    FILE *out = fopen(outputPath, "rb");
+    // 3. Save: magic number, ID, then the code lengths
+    FILE* out = fopen(outputPath, "wb");
     if (!out) {
-        // compressFile must have failed
+        perror("Error opening output file");
         return -1;
     }
-    fclose(out);
-    
-    return 0; // Return 0 on success
+    unsigned char packed[CODE_LENGTHS_MAX_SIZE];
+    size_t packedSize = packCodeLengths(lengths, packed);
+    int failed = fwrite(&MAGIC_NUMBER_DICTIONARY, sizeof(unsigned int), 1, out) != 1 ||
+                 fwrite(&id, sizeof(unsigned), 1, out) != 1 ||
+                 fwrite(packed, 1, packedSize, out) != packedSize;
+    if (fclose(out) != 0 || failed) {
+        fprintf(stderr, "Error: Failed to write dictionary '%s'.\n", outputPath);
+        return -1;
+    }
+
+    if (registerDictionary(id, lengths) != 0) {
+        fprintf(stderr, "Error: Too many dictionaries.\n");
+        return -1;
+    }
+    return id;
 }
 
-int api_decompress_file(const char* inputPath, const char* outputPath) {
-    FILE *in = fopen(inputPath, "rb");
+long long trainDictionary(const unsigned char* samples, size_t size, unsigned id, const char* outputPath) {
+    unsigned long long freqTable[NUM_CHARS] = {0};
+    countFrequencies(samples, size, freqTable);
+    return saveTrainedDictionary(freqTable, id, outputPath);
+}
+
+long long trainDictionaryFromFiles(const char* const* samplePaths, int count, unsigned id, const char* outputPath) {
+    unsigned long long freqTable[NUM_CHARS] = {0};
+    for (int i = 0; i < count; ++i) {
+        FILE* in = fopen(samplePaths[i], "rb");
+        if (!in) {
+            perror("Error opening sample file");
+            return -1;
+        }
+        countStreamFrequencies(in, freqTable);
+        int failed = ferror(in);
+        fclose(in);
+        if (failed) {
+            fprintf(stderr, "Error: Failed to read sample '%s'.\n", samplePaths[i]);
+            return -1;
+        }
+    }
+    return saveTrainedDictionary(freqTable, id, outputPath);
+}
+
+long long loadDictionary(const char* path) {
+    FILE* in = fopen(path, "rb");
     if (!in) {
-        perror("API: Failed to open input file");
+        perror("Error opening dictionary file");
         return -1;
     }
+    unsigned int magic = 0;
+    unsigned id = 0;
+    unsigned char lengths[NUM_CHARS];
+    int failed = fread(&magic, sizeof(unsigned int), 1, in) != 1 || magic != MAGIC_NUMBER_DICTIONARY ||
+                 fread(&id, sizeof(unsigned), 1, in) != 1 || id == 0 ||
+                 readCodeLengths(in, lengths) != 0;
     fclose(in);
+    if (failed) {
+        fprintf(stderr, "Error: '%s' is not a valid dictionary file.\n", path);
+        return -1;
+    }
+    if (registerDictionary(id, lengths) != 0) {
+        fprintf(stderr, "Error: Too many dictionaries.\n");
+        return -1;
+    }
+    return id;
+}
 
-    decompressFile(inputPath, outputPath);
+void setDictionary(unsigned id) {
+    dictionaryId = id;
+}
 
-    // We should check if the output file was successfully created
-    // and is not empty (unless original was empty)
-    FILE *out = fopen(outputPath, "rb");
-    if (!out) {
-        // decompressFile must have failed
-        return -1;
+unsigned getDictionary(void) {
+    return dictionaryId;
+}
+
+// --- Decode Table Construction ---
+
+// Depth of the deepest leaf below 'node' (0 for a leaf)
+static int subtreeDepth(const HuffTree* tree, unsigned short node) {
+    if (node == HUFF_TREE_NONE || isLeaf(&tree->nodes[node])) return 0;
+    int l = subtreeDepth(tree, tree->nodes[node].left);
+    int r = subtreeDepth(tree, tree->nodes[node].right);
+    return 1 + (l > r ? l : r);
+}
+
+// Fills 'entries' (a table indexed by 'width' bits) for every code below
+// 'node', where 'code' holds the 'len' bits already taken to reach it.
+static void fillSecondary(DecodeTable* table, DecodeEntry* entries, int width,
+                          unsigned short node, unsigned code, int len) {
+    if (node == HUFF_TREE_NONE) return;
+    const Node* n = &table->tree->nodes[node];
+
+    if (isLeaf(n)) {
+        // Every index that starts with this code decodes to this leaf
+        unsigned first = code << (width - len);
+        unsigned span = 1u << (width - len);
+        for (unsigned i = 0; i < span; ++i) {
+            entries[first + i].symbols = n->data;
+            entries[first + i].bits = (unsigned char)len;
+            entries[first + i].count = 1;
+        }
+        return;
     }
-    fclose(out);
-    
-    return 0; // Return 0 on success
+
+    if (len == width) {
+        // Code is longer than the table: resume from this node bit by bit
+        entries[code].symbols = (unsigned short)table->escapeCount;
+        entries[code].bits = (unsigned char)len;
+        entries[code].count = DECODE_ESCAPE;
+        table->escapes[table->escapeCount++] = node;
+        return;
+    }
+
+    fillSecondary(table, entries, width, n->left, code << 1, len + 1);
+    fillSecondary(table, entries, width, n->right, (code << 1) | 1, len + 1);
+}
+
+// Appends a zeroed secondary table of 'width' bits and links primary[prefix] to it.
+// Returns NULL if it cannot be allocated.
+static DecodeEntry* addSecondaryTable(DecodeTable* table, unsigned prefix, int width) {
+    unsigned size = 1u << width;
+    unsigned n = table->secondaryCount;
+    unsigned* offsets = (unsigned*)realloc(table->secondaryOffset, (n + 1) * sizeof(unsigned));
+    if (offsets) table->secondaryOffset = offsets;
+    DecodeEntry* secondary = (DecodeEntry*)realloc(table->secondary,
+                                                   (table->secondarySize + size) * sizeof(DecodeEntry));
+    if (secondary) table->secondary = secondary;
+    if (!offsets || !secondary) {
+        perror("malloc error (addSecondaryTable)");
+        return NULL;
+    }
+    table->secondaryOffset[n] = table->secondarySize;
+    memset(&table->secondary[table->secondarySize], 0, size * sizeof(DecodeEntry));
+    table->secondarySize += size;
+    table->secondaryCount++;
+
+    table->primary[prefix].symbols = (unsigned short)n;
+    table->primary[prefix].bits = (unsigned char)width;
+    table->primary[prefix].count = DECODE_LINK;
+
+    return &table->secondary[table->secondaryOffset[n]];
+}
+
+// Where a short code leaves enough bits for another whole code,
+// emit both symbols from the same primary probe.
+static void pairPrimaryEntries(DecodeTable* table) {
+    DecodeEntry single[1 << DECODE_PRIMARY_BITS];
+    memcpy(single, table->primary, sizeof(single));
+    const unsigned mask = (1u << DECODE_PRIMARY_BITS) - 1;
+    for (unsigned i = 0; i <= mask; ++i) {
+        DecodeEntry first = single[i];
+        if (first.count != 1) continue;
+        DecodeEntry second = single[(i << first.bits) & mask];
+        if (second.count == 1 && first.bits + second.bits <= DECODE_PRIMARY_BITS) {
+            table->primary[i].symbols = (unsigned short)(first.symbols | (second.symbols << 8));
+            table->primary[i].bits = (unsigned char)(first.bits + second.bits);
+            table->primary[i].count = 2;
+            table->pairFirstBits[first.symbols] = first.bits;
+        }
+    }
+}
+
+// Fills the primary table, allocating a secondary table for every
+// DECODE_PRIMARY_BITS-long prefix that still has codes below it.
+// Returns 0, or -1 if an allocation fails.
+static int fillPrimary(DecodeTable* table, unsigned short node, unsigned code, int len) {
+    if (node == HUFF_TREE_NONE) return 0;
+    const Node* n = &table->tree->nodes[node];
+
+    if (isLeaf(n) || len < DECODE_PRIMARY_BITS) {
+        if (isLeaf(n)) {
+            fillSecondary(table, table->primary, DECODE_PRIMARY_BITS, node, code, len);
+            return 0;
+        }
+        if (fillPrimary(table, n->left, code << 1, len + 1) != 0) return -1;
+        return fillPrimary(table, n->right, (code << 1) | 1, len + 1);
+    }
+
+    // Internal node at the primary width: link to a new secondary table
+    int width = subtreeDepth(table->tree, node);
+    if (width > DECODE_SECONDARY_BITS) width = DECODE_SECONDARY_BITS;
+    DecodeEntry* entries = addSecondaryTable(table, code, width);
+    if (!entries) return -1;
+    fillSecondary(table, entries, width, n->left, 0, 1);
+    fillSecondary(table, entries, width, n->right, 1, 1);
+    return 0;
+}
+
+DecodeTable* buildDecodeTable(const HuffTree* tree) {
+    DecodeTable* table = (DecodeTable*)calloc(1, sizeof(DecodeTable));
+    if (!table) {
+        perror("malloc error (buildDecodeTable)");
+        return NULL;
+    }
+    table->tree = tree;
+    if (tree->root == HUFF_TREE_NONE) return table;
+
+    // 1. One symbol per entry
+    const Node* root = &tree->nodes[tree->root];
+    if (fillPrimary(table, root->left, 0, 1) != 0 || fillPrimary(table, root->right, 1, 1) != 0) {
+        freeDecodeTable(table);
+        return NULL;
+    }
+
+    // 2. Two symbols per entry where they fit
+    pairPrimaryEntries(table);
+
+    return table;
+}
+
+// Builds the tables for canonical codes into 'table', reusing its
+// secondary table allocations. Returns 0, or -1 if an allocation fails.
+static int fillDecodeTableFromCodes(DecodeTable* table, const HuffCode codes[NUM_CHARS]) {
+    memset(table->primary, 0, sizeof(table->primary));
+    memset(table->pairFirstBits, 0, sizeof(table->pairFirstBits));
+    table->secondaryCount = 0;
+    table->secondarySize = 0;
+    table->tree = NULL;
+    table->escapeCount = 0;
+
+    // 1. Secondary table width for every primary prefix of a long code
+    unsigned char width[1 << DECODE_PRIMARY_BITS];
+    int longCodes = 0;
+    for (int i = 0; i < NUM_CHARS; ++i) {
+        int extra = codes[i].length - DECODE_PRIMARY_BITS;
+        if (extra <= 0) continue;
+        if (!longCodes++) memset(width, 0, sizeof(width));
+        unsigned prefix = (unsigned)(codes[i].bits >> extra);
+        if (extra > width[prefix]) width[prefix] = (unsigned char)extra;
+    }
+    for (unsigned p = 0; longCodes && p < (1u << DECODE_PRIMARY_BITS); ++p) {
+        if (width[p] && !addSecondaryTable(table, p, width[p])) return -1;
+    }
+
+    // 2. One symbol per entry
+    for (int i = 0; i < NUM_CHARS; ++i) {
+        int length = codes[i].length;
+        if (length == 0) continue;
+
+        DecodeEntry* entries = table->primary;
+        int tableBits = DECODE_PRIMARY_BITS;
+        unsigned code = (unsigned)codes[i].bits;
+        int bits = length;
+        if (length > DECODE_PRIMARY_BITS) {
+            // Index the secondary table with the bits after the prefix
+            int extra = length - DECODE_PRIMARY_BITS;
+            DecodeEntry link = table->primary[code >> extra];
+            entries = &table->secondary[table->secondaryOffset[link.symbols]];
+            tableBits = link.bits;
+            code &= (1u << extra) - 1;
+            bits = extra;
+        }
+
+        unsigned first = code << (tableBits - bits);
+        unsigned span = 1u << (tableBits - bits);
+        DecodeEntry entry = {(unsigned short)i, (unsigned char)bits, 1};
+        for (unsigned j = 0; j < span; ++j) entries[first + j] = entry;
+    }
+
+    // 3. Two symbols per entry where they fit
+    pairPrimaryEntries(table);
+    return 0;
+}
+
+DecodeTable* buildDecodeTableFromCodes(const HuffCode codes[NUM_CHARS]) {
+    DecodeTable* table = (DecodeTable*)calloc(1, sizeof(DecodeTable));
+    if (!table) {
+        perror("malloc error (buildDecodeTableFromCodes)");
+        return NULL;
+    }
+    if (fillDecodeTableFromCodes(table, codes) != 0) {
+        freeDecodeTable(table);
+        return NULL;
+    }
+    return table;
+}
+
+void freeDecodeTable(DecodeTable* table) {
+    if (table == NULL) return;
+    free(table->secondary);
+    free(table->secondaryOffset);
+    free(table);
+}
+
+void setDecoderMode(DecoderMode mode) {
+    decoderMode = mode;
+}
+
+DecoderMode getDecoderMode(void) {
+    return decoderMode;
+}
+
+void setBlockSize(size_t size) {
+    blockSize = size > HUFF_MAX_BLOCK_SIZE ? HUFF_MAX_BLOCK_SIZE : size;
+}
+
+size_t getBlockSize(void) {
+    return blockSize;
+}
+
+void setThreadCount(int threads) {
+    threadCount = threads < 0 ? 0 : threads;
+}
+
+int getThreadCount(void) {
+    return threadCount;
+}
+
+void setStreamCount(int streams) {
+    streamCount = streams >= HUFF_INTERLEAVED_STREAMS ? HUFF_INTERLEAVED_STREAMS : 1;
+}
+
+int getStreamCount(void) {
+    return streamCount;
+}
+
+void setMaxCodeLength(int length) {
+    if (length < HUFF_MIN_CODE_LENGTH_LIMIT) length = HUFF_MIN_CODE_LENGTH_LIMIT;
+    if (length > HUFF_MAX_CODE_LENGTH) length = HUFF_MAX_CODE_LENGTH;
+    maxCodeLength = length;
+}
+
+int getMaxCodeLength(void) {
+    return maxCodeLength;
+}
+
+// --- Frequency Counting ---
+
+// Counting into one table stalls on runs of the same byte: every increment
+// has to wait for the store of the previous one. Spreading consecutive bytes
+// over several sub-histograms keeps those chains independent. The 32-bit
+// sub-counts are folded into freqTable every HISTOGRAM_SLICE bytes so they
+// cannot overflow.
+#define HISTOGRAM_SLICE (1u << 30)
+
+#ifdef HUFF_SSE2_HISTOGRAM
+// 16-byte loads spread over 8 sub-histograms
+static void histogramSlice(const unsigned char* data, size_t size, unsigned long long freqTable[NUM_CHARS]) {
+    unsigned counts[8][NUM_CHARS];
+    memset(counts, 0, sizeof(counts));
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned long long lo = (unsigned long long)_mm_cvtsi128_si64(v);
+        unsigned long long hi = (unsigned long long)_mm_cvtsi128_si64(_mm_unpackhi_epi64(v, v));
+        for (int k = 0; k < 8; ++k) {
+            counts[k][(lo >> (8 * k)) & 0xFF]++;
+        }
+        for (int k = 0; k < 8; ++k) {
+            counts[k][(hi >> (8 * k)) & 0xFF]++;
+        }
+    }
+    for (; i < size; ++i) {
+        counts[0][data[i]]++;
+    }
+
+    for (int c = 0; c < NUM_CHARS; ++c) {
+        unsigned long long sum = 0;
+        for (int k = 0; k < 8; ++k) sum += counts[k][c];
+        freqTable[c] += sum;
+    }
+}
+#else
+// 8-byte loads spread over 4 sub-histograms
+static void histogramSlice(const unsigned char* data, size_t size, unsigned long long freqTable[NUM_CHARS]) {
+    unsigned counts[4][NUM_CHARS];
+    memset(counts, 0, sizeof(counts));
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        unsigned long long w;
+        memcpy(&w, data + i, sizeof(w));
+        counts[0][w & 0xFF]++;
+        counts[1][(w >> 8) & 0xFF]++;
+        counts[2][(w >> 16) & 0xFF]++;
+        counts[3][(w >> 24) & 0xFF]++;
+        counts[0][(w >> 32) & 0xFF]++;
+        counts[1][(w >> 40) & 0xFF]++;
+        counts[2][(w >> 48) & 0xFF]++;
+        counts[3][w >> 56]++;
+    }
+    for (; i < size; ++i) {
+        counts[0][data[i]]++;
+    }
+
+    for (int c = 0; c < NUM_CHARS; ++c) {
+        freqTable[c] += (unsigned long long)counts[0][c] + counts[1][c] + counts[2][c] + counts[3][c];
+    }
+}
+#endif
+
+// --- Kernel Dispatch ---
+
+// Portable grouping of four codes, for CPUs without a packing kernel
+static void packCodesPortable(const unsigned char* data, size_t count, const unsigned codes[NUM_CHARS],
+                              unsigned long long* groups, unsigned char* groupLengths) {
+    for (size_t i = 0, g = 0; i < count; i += 4, ++g) {
+        unsigned e0 = codes[data[i]], e1 = codes[data[i + 1]];
+        unsigned e2 = codes[data[i + 2]], e3 = codes[data[i + 3]];
+        unsigned long long value = e0 & 0xFFFFFF;
+        value = (value << (e1 >> 24)) | (e1 & 0xFFFFFF);
+        value = (value << (e2 >> 24)) | (e2 & 0xFFFFFF);
+        value = (value << (e3 >> 24)) | (e3 & 0xFFFFFF);
+        groups[g] = value;
+        groupLengths[g] = (unsigned char)((e0 >> 24) + (e1 >> 24) + (e2 >> 24) + (e3 >> 24));
+    }
+}
+
+// Kernels in use: the portable (or SSE2, which every x86-64 CPU has)
+// versions until selectKernels finds something better
+static HistogramKernel histogramKernel = histogramSlice;
+static PackCodesKernel packCodesKernel = packCodesPortable;
+#ifdef HUFF_SSE2_HISTOGRAM
+static const char* kernelName = "sse2";
+#else
+static const char* kernelName = "portable";
+#endif
+
+#ifdef HUFF_AVX2_KERNELS
+// Runs once at load time, before main or dlopen returns, so the pointers
+// never change while another thread reads them. HUFFMAN_KERNELS=portable
+// in the environment keeps the fallbacks (for testing and benchmarks).
+__attribute__((constructor)) static void selectKernels(void) {
+    const char* forced = getenv("HUFFMAN_KERNELS");
+    if (forced && strcmp(forced, "portable") == 0) return;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        histogramKernel = histogramAvx2;
+        packCodesKernel = packCodesAvx2;
+        kernelName = "avx2";
+    }
+}
+#endif
+
+const char* getKernelName(void) {
+    return kernelName;
+}
+
+// --- Histogram Entry Points ---
+
+void countFrequencies(const unsigned char* data, size_t size, unsigned long long freqTable[NUM_CHARS]) {
+    while (size > 0) {
+        size_t n = size < HISTOGRAM_SLICE ? size : HISTOGRAM_SLICE;
+        histogramKernel(data, n, freqTable);
+        data += n;
+        size -= n;
+    }
+}
+
+unsigned long long countStreamFrequencies(FILE* in, unsigned long long freqTable[NUM_CHARS]) {
+    // Short of memory, count in small reads instead
+    unsigned char small[4096];
+    size_t capacity = READ_BLOCK_SIZE;
+    unsigned char* buffer = (unsigned char*)malloc(capacity);
+    if (!buffer) {
+        buffer = small;
+        capacity = sizeof(small);
+    }
+
+    unsigned long long total = 0;
+    size_t n;
+    while ((n = readBuffer(buffer, capacity, in)) > 0) {
+        countFrequencies(buffer, n, freqTable);
+        total += n;
+    }
+
+    if (buffer != small) free(buffer);
+    return total;
+}
+
+// --- Bit Writer ---
+
+// Packs codes MSB first into a 64-bit accumulator and stores whole
+// big-endian words into an output buffer. With a stream the buffer is
+// written out when full; without one it grows and holds the whole output,
+// or, for a caller's buffer, fills it and flags an overflow. If memory
+// runs out or a write fails the writer flags a failure instead; either
+// way it keeps accepting bits so the encoder can finish, and drops them.
+typedef struct BitWriter {
+    FILE* out;              // NULL: keep everything in 'buffer'
+    unsigned char* buffer;
+    size_t pos, capacity;
+    int owned;              // 0: 'buffer' is the caller's (or 'spare') and cannot grow
+    int overflow;           // The caller's buffer was too small; the rest was dropped
+    int failed;             // An allocation or a write failed; the rest was dropped
+    unsigned long long acc; // Pending bits, left-aligned
+    int count;              // Number of pending bits (0-63)
+    unsigned char spare[64]; // Where dropped bytes go when there is no other buffer
+} BitWriter;
+
+// Drops everything from here on into 'spare' (the caller's buffer stays
+// untouched past what was written)
+static void dropOutput(BitWriter* bw) {
+    bw->buffer = bw->spare;
+    bw->capacity = sizeof(bw->spare);
+    bw->pos = 0;
+}
+
+// Flags a failure: the rest of the output is dropped, into the writer's
+// own buffer if it has one (IO_BUFFER_SIZE at least), otherwise 'spare'
+static void failWriter(BitWriter* bw) {
+    bw->failed = 1;
+    bw->out = NULL;
+    bw->pos = 0;
+    if (!bw->owned) dropOutput(bw);
+}
+
+static void initBitWriter(BitWriter* bw, FILE* out) {
+    bw->out = out;
+    bw->capacity = IO_BUFFER_SIZE;
+    bw->buffer = (unsigned char*)malloc(bw->capacity);
+    bw->pos = 0;
+    bw->owned = (bw->buffer != NULL);
+    bw->overflow = 0;
+    bw->failed = 0;
+    bw->acc = 0;
+    bw->count = 0;
+    if (!bw->buffer) {
+        perror("malloc error (initBitWriter)");
+        failWriter(bw);
+    }
+}
+
+// In-memory writer; 'capacity' should be the expected output size (if it
+// cannot be allocated up front, the buffer grows as it fills)
+static void initBitWriterMemory(BitWriter* bw, size_t capacity) {
+    initBitWriter(bw, NULL);
+    if (capacity > bw->capacity && bw->owned) {
+        unsigned char* buffer = (unsigned char*)malloc(capacity);
+        if (buffer) {
+            free(bw->buffer);
+            bw->buffer = buffer;
+            bw->capacity = capacity;
+        }
+    }
+}
+
+// Writer over the caller's buffer dest[0..capacity)
+static void initBitWriterBuffer(BitWriter* bw, unsigned char* dest, size_t capacity) {
+    bw->out = NULL;
+    bw->buffer = dest;
+    bw->capacity = capacity;
+    bw->pos = 0;
+    bw->owned = 0;
+    bw->overflow = 0;
+    bw->failed = 0;
+    bw->acc = 0;
+    bw->count = 0;
+}
+
+// Writes bytes to the writer's stream; a short write fails the writer
+static void writeOut(BitWriter* bw, const void* src, size_t n) {
+    if (writeBuffer(src, n, bw->out) != n) failWriter(bw);
+}
+
+// Makes room for 'n' more bytes in the buffer (at most IO_BUFFER_SIZE
+// for streams, and the buffer's size once output is being dropped)
+static void reserveBytes(BitWriter* bw, size_t n) {
+    if (bw->pos + n <= bw->capacity) return;
+    if (bw->out || bw->overflow || bw->failed) {
+        // Write out what we have, or drop it after an overflow or a failure
+        if (bw->out) writeOut(bw, bw->buffer, bw->pos);
+        bw->pos = 0;
+        return;
+    }
+    if (!bw->owned) {
+        // The caller's buffer is full: keep going so the encoder can
+        // finish, but drop the output
+        bw->overflow = 1;
+        dropOutput(bw);
+        return;
+    }
+    size_t capacity = bw->capacity;
+    while (bw->pos + n > capacity) capacity *= 2;
+    unsigned char* buffer = (unsigned char*)realloc(bw->buffer, capacity);
+    if (!buffer) {
+        perror("malloc error (reserveBytes)");
+        failWriter(bw);
+        return;
+    }
+    bw->buffer = buffer;
+    bw->capacity = capacity;
+}
+
+static void flushWord(BitWriter* bw) {
+    reserveBytes(bw, 8);
+    unsigned char* p = bw->buffer + bw->pos;
+    for (int i = 0; i < 8; ++i) {
+        p[i] = (unsigned char)(bw->acc >> (56 - 8 * i));
+    }
+    bw->pos += 8;
+}
+
+static inline void putBits(BitWriter* bw, unsigned long long bits, int length) {
+    int room = 64 - bw->count;
+    if (length < room) {
+        bw->acc |= bits << (room - length);
+        bw->count += length;
+    } else {
+        // Fill the word with the top bits of the code, keep the rest
+        int rest = length - room;
+        bw->acc |= bits >> rest;
+        flushWord(bw);
+        bw->acc = rest ? bits << (64 - rest) : 0;
+        bw->count = rest;
+    }
+}
+
+// Appends raw bytes; the writer must be byte-aligned (no pending bits)
+static void putBytes(BitWriter* bw, const void* src, size_t n) {
+    reserveBytes(bw, n);
+    if (bw->pos + n <= bw->capacity) {
+        memcpy(bw->buffer + bw->pos, src, n);
+        bw->pos += n;
+    } else if (bw->out) {
+        writeOut(bw, src, n); // Larger than the buffer: write it directly
+    }
+}
+
+// Appends the code of every byte in data[0..size)
+// Codes are packed ENCODE_CHUNK symbols at a time into a small buffer
+#define ENCODE_CHUNK 1024
+
+// Encodes data[0..size) with encoder codes (at most HUFF_MAX_CODE_LENGTH
+// bits). The packing kernel concatenates four codes at a time, so each
+// putBits writes up to 60 bits instead of one code.
+static void encodeSymbols(BitWriter* bw, const unsigned char* data, size_t size,
+                          const HuffCode codes[NUM_CHARS]) {
+    unsigned table[NUM_CHARS];
+    for (int c = 0; c < NUM_CHARS; ++c) table[c] = KERNEL_CODE(codes[c].bits, codes[c].length);
+
+    unsigned long long groups[ENCODE_CHUNK / 4];
+    unsigned char groupLengths[ENCODE_CHUNK / 4];
+    size_t i = 0;
+    while (size - i >= 4) {
+        size_t n = (size - i < ENCODE_CHUNK) ? (size - i) & ~(size_t)3 : ENCODE_CHUNK;
+        packCodesKernel(data + i, n, table, groups, groupLengths);
+        for (size_t g = 0; g < n / 4; ++g) putBits(bw, groups[g], groupLengths[g]);
+        i += n;
+    }
+    for (; i < size; ++i) {
+        HuffCode code = codes[data[i]];
+        putBits(bw, code.bits, code.length);
+    }
+}
+
+// Writes the pending bits, zero-padded to a byte. A stream writer also
+// writes out the rest of its buffer.
+static void finishBits(BitWriter* bw) {
+    reserveBytes(bw, (size_t)(bw->count + 7) / 8); // Only what is pending, so an exact-size buffer fits
+    while (bw->count > 0) {
+        bw->buffer[bw->pos++] = (unsigned char)(bw->acc >> 56);
+        bw->acc <<= 8;
+        bw->count -= 8;
+    }
+    bw->acc = 0;
+    bw->count = 0;
+    if (bw->out) {
+        writeOut(bw, bw->buffer, bw->pos);
+        bw->pos = 0;
+    }
+}
+
+static void freeBitWriter(BitWriter* bw) {
+    if (bw->owned) free(bw->buffer);
+}
+
+// --- Context Resources ---
+
+// What a HuffContext keeps between calls
+struct HuffContext {
+    ThreadPool* pool;           // Block mode workers (NULL until needed)
+    int poolThreads;            // Size the pool was started with
+    int maxPoolThreads;         // Cap on the pool size, or 0 for threadCount
+    int quiet;                  // No progress messages from the file API
+    DecodeTable* table;         // Last table decode on the calling thread
+    unsigned char tableLengths[NUM_CHARS]; // Code lengths 'table' was built for
+    BitWriter out;              // Output of contextCompress
+    unsigned char* decoded;     // Output of contextDecompress
+    size_t decodedCapacity;
+};
+
+// Context of the contextCompress/contextDecompress call running on this
+// thread, or NULL. Block workers never see one.
+static _Thread_local HuffContext* activeContext = NULL;
+
+// Process-wide pool for block mode outside a context, started on first
+// use. A caller that finds it busy (another thread's blocks) starts its
+// own pool instead, since waitForJobs waits for every job in a pool.
+static pthread_mutex_t sharedPoolLock = PTHREAD_MUTEX_INITIALIZER;
+static ThreadPool* sharedPool = NULL;
+static int sharedPoolThreads = 0;
+static int sharedPoolBusy = 0;
+
+// The worker pool for 'jobs' block jobs: the active context's, started
+// once and kept while threadCount is unchanged, or the shared one. Returns
+// NULL when the jobs should run inline: a single job, a single worker, or
+// no threads to be had.
+static ThreadPool* acquirePool(unsigned long long jobs) {
+    HuffContext* ctx = activeContext;
+    int threads = (ctx && ctx->maxPoolThreads > 0) ? ctx->maxPoolThreads : threadCount;
+    if (threads <= 0) threads = onlineCpuCount();
+    if (jobs <= 1 || threads == 1) return NULL;
+
+    if (ctx) {
+        if (!ctx->pool || ctx->poolThreads != threads) {
+            if (ctx->pool) freeThreadPool(ctx->pool);
+            ctx->pool = createThreadPool(threads);
+            ctx->poolThreads = threads;
+        }
+        return ctx->pool;
+    }
+
+    pthread_mutex_lock(&sharedPoolLock);
+    ThreadPool* pool = NULL;
+    if (!sharedPoolBusy) {
+        if (!sharedPool || sharedPoolThreads != threads) {
+            if (sharedPool) freeThreadPool(sharedPool);
+            sharedPool = createThreadPool(threads);
+            sharedPoolThreads = threads;
+        }
+        sharedPoolBusy = (sharedPool != NULL);
+        pool = sharedPool;
+    }
+    pthread_mutex_unlock(&sharedPoolLock);
+    return pool ? pool : createThreadPool(threads);
+}
+
+static void releasePool(ThreadPool* pool) {
+    if (!pool || (activeContext && pool == activeContext->pool)) return;
+    pthread_mutex_lock(&sharedPoolLock);
+    int shared = (pool == sharedPool);
+    if (shared) sharedPoolBusy = 0;
+    pthread_mutex_unlock(&sharedPoolLock);
+    if (!shared) freeThreadPool(pool);
+}
+
+// Runs job(arg) on 'pool', or right away without one (see acquirePool)
+// or if it cannot be queued
+static void submitPoolJob(ThreadPool* pool, ThreadJob job, void* arg) {
+    if (!pool || submitJob(pool, job, arg) != 0) job(arg);
+}
+
+static void waitForPoolJobs(ThreadPool* pool) {
+    if (pool) waitForJobs(pool);
+}
+
+// Workers of a pool from acquirePool
+static int poolSize(ThreadPool* pool) {
+    return pool ? threadPoolSize(pool) : 1;
+}
+
+// Prints a progress message of the file API, unless the active context is
+// quiet (batch workers)
+static void reportStatus(const char* message) {
+    if (!activeContext || !activeContext->quiet) printf("%s\n", message);
+}
+
+// A decode table for canonical codes: the active context's, or a new one.
+// Canonical codes follow from their lengths, so the context's table is
+// only rebuilt when the lengths differ from last time. Returns NULL if
+// memory runs out.
+static DecodeTable* acquireDecodeTable(const HuffCode codes[NUM_CHARS]) {
+    HuffContext* ctx = activeContext;
+    if (!ctx) return buildDecodeTableFromCodes(codes);
+    if (!ctx->table) {
+        ctx->table = (DecodeTable*)calloc(1, sizeof(DecodeTable));
+        if (!ctx->table) {
+            perror("malloc error (acquireDecodeTable)");
+            return NULL;
+        }
+    } else {
+        int same = 1;
+        for (int i = 0; i < NUM_CHARS; ++i) same &= (ctx->tableLengths[i] == codes[i].length);
+        if (same) return ctx->table;
+    }
+    if (fillDecodeTableFromCodes(ctx->table, codes) != 0) {
+        // Half built: drop it so the next call starts over
+        freeDecodeTable(ctx->table);
+        ctx->table = NULL;
+        return NULL;
+    }
+    for (int i = 0; i < NUM_CHARS; ++i) ctx->tableLengths[i] = codes[i].length;
+    return ctx->table;
+}
+
+// Frees any decode table except the active context's
+static void releaseDecodeTable(DecodeTable* table) {
+    if (!activeContext || table != activeContext->table) freeDecodeTable(table);
+}
+
+// --- Memory-Mapped I/O ---
+
+// A whole input file in memory: mapped when it is a regular file,
+// otherwise read in through buffered stream reads.
+typedef struct InputMap {
+    const unsigned char* data;
+    size_t size;
+    int mapped; // 1 if 'data' is a mapping, 0 if it was malloc'd
+} InputMap;
+
+// Maps the whole of a regular file. Returns 0 on success, -1 if the file
+// cannot be mapped (pipes, devices, or no mmap on this platform).
+static int mapFile(int fd, InputMap* map) {
+#ifdef HUFF_HAVE_MMAP
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return -1;
+
+    map->size = (size_t)st.st_size;
+    map->mapped = 0;
+    map->data = NULL;
+    if (map->size == 0) return 0; // Nothing to map
+
+    unsigned long long start = statsTarget ? nowNs() : 0;
+    void* data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) return -1;
+    madvise(data, map->size, MADV_SEQUENTIAL);
+    map->data = (const unsigned char*)data;
+    map->mapped = 1;
+    if (statsTarget) {
+        statsTarget->stageNs[HUFF_STAGE_READ] += nowNs() - start;
+        statsTarget->mapCalls++;
+        statsTarget->bytesIn += map->size;
+    }
+    return 0;
+#else
+    (void)fd;
+    (void)map;
+    return -1;
+#endif
+}
+
+// Reads the rest of a stream into a growing buffer. Returns 0 on success,
+// -1 on a read error or if memory runs out.
+static int readStream(FILE* in, InputMap* map) {
+    size_t capacity = READ_BLOCK_SIZE, size = 0;
+    unsigned char* data = (unsigned char*)malloc(capacity);
+    if (!data) {
+        perror("malloc error (readStream)");
+        return -1;
+    }
+
+    size_t n;
+    while ((n = readBuffer(data + size, capacity - size, in)) > 0) {
+        size += n;
+        if (size == capacity) {
+            capacity *= 2;
+            unsigned char* grown = (unsigned char*)realloc(data, capacity);
+            if (!grown) {
+                perror("malloc error (readStream)");
+                free(data);
+                return -1;
+            }
+            data = grown;
+        }
+    }
+    if (ferror(in)) {
+        free(data);
+        return -1;
+    }
+
+    map->data = data;
+    map->size = size;
+    map->mapped = 0;
+    return 0;
+}
+
+static void releaseInput(InputMap* map) {
+#ifdef HUFF_HAVE_MMAP
+    if (map->mapped) {
+        munmap((void*)map->data, map->size);
+        return;
+    }
+#endif
+    free((void*)map->data);
+}
+
+// A pre-sized output file mapped for writing
+typedef struct OutputMap {
+    int fd;
+    unsigned char* data;
+    size_t size;
+} OutputMap;
+
+// Creates 'path' with 'size' bytes and maps it. The blocks are allocated
+// up front: a store to a sparse mapping on a full disk raises SIGBUS,
+// where a stream write just fails. Returns 0 on success, -1 if the output
+// should be written through a stream instead (pipes, devices, no room for
+// the file, or no mmap or posix_fallocate on this platform).
+static int mapOutputFile(const char* path, unsigned long long size, OutputMap* map) {
+#if defined(HUFF_HAVE_MMAP) && !defined(__APPLE__)
+    struct stat st;
+    if (stat(path, &st) == 0 && !S_ISREG(st.st_mode)) return -1;
+    if (size == 0 || size > (size_t)-1) return -1;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) return -1;
+    if (posix_fallocate(fd, 0, (off_t)size) != 0) {
+        close(fd);
+        return -1;
+    }
+    void* data = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    map->fd = fd;
+    map->data = (unsigned char*)data;
+    map->size = (size_t)size;
+    if (statsTarget) {
+        statsTarget->mapCalls++;
+        statsTarget->bytesOut += map->size;
+    }
+    return 0;
+#else
+    (void)path;
+    (void)size;
+    (void)map;
+    return -1;
+#endif
+}
+
+// Unmaps the output, trimming it to the bytes actually written. Returns
+// 0 on success, -1 if the file could not be trimmed or closed.
+static int unmapOutputFile(OutputMap* map, size_t written) {
+#ifdef HUFF_HAVE_MMAP
+    int rc = 0;
+    munmap(map->data, map->size);
+    if (written != map->size && ftruncate(map->fd, (off_t)written) != 0) {
+        perror("Failed to trim output file");
+        rc = -1;
+    }
+    if (close(map->fd) != 0) {
+        perror("Failed to write output file");
+        rc = -1;
+    }
+    return rc;
+#else
+    (void)map;
+    (void)written;
+    return -1;
+#endif
+}
+
+// Closes an output stream. Returns 0 on success, -1 if any write to it
+// failed (a full disk often only shows up when the last buffer is flushed).
+static int closeOutput(FILE* out) {
+    int failed = ferror(out);
+    if (fclose(out) != 0) failed = 1;
+    if (failed) fprintf(stderr, "Error: Failed to write output file.\n");
+    return failed ? -1 : 0;
+}
+
+// Removes the partial output of a failed decode. Only regular files are
+// removed, so pipes and devices such as /dev/stdout are left alone.
+static void discardOutput(const char* path) {
+#ifdef HUFF_HAVE_MMAP
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) return;
+#endif
+    remove(path);
+}
+
+// --- Bit Reader ---
+
+// MSB-first bit reader over a memory buffer or a stream.
+// 'acc' holds the next 'count' input bits left-aligned; bits below them are
+// either more input or zeros once the input is exhausted.
+typedef struct BitReader {
+    FILE* in;                  // NULL when reading from memory
+    const unsigned char* data; // Current input block
+    size_t pos, len;
+    unsigned char* buffer;     // Stream read buffer (owned)
+    unsigned long long acc;
+    int count;
+} BitReader;
+
+static void initBitReaderMemory(BitReader* br, const unsigned char* data, size_t size) {
+    br->in = NULL;
+    br->data = data;
+    br->pos = 0;
+    br->len = size;
+    br->buffer = NULL;
+    br->acc = 0;
+    br->count = 0;
+}
+
+// Returns 0, or -1 if the read buffer cannot be allocated
+static int initBitReaderStream(BitReader* br, FILE* in) {
+    br->in = in;
+    br->buffer = (unsigned char*)malloc(IO_BUFFER_SIZE);
+    if (!br->buffer) {
+        perror("malloc error (initBitReaderStream)");
+        return -1;
+    }
+    br->data = br->buffer;
+    br->pos = br->len = 0;
+    br->acc = 0;
+    br->count = 0;
+    return 0;
+}
+
+static void freeBitReader(BitReader* br) {
+    free(br->buffer);
+}
+
+static void refillBits(BitReader* br) {
+    while (br->count <= 56) {
+        if (br->pos == br->len) {
+            if (br->in == NULL) return;
+            br->len = readBuffer(br->buffer, IO_BUFFER_SIZE, br->in);
+            br->pos = 0;
+            if (br->len == 0) return;
+        }
+        br->acc |= (unsigned long long)br->data[br->pos++] << (56 - br->count);
+        br->count += 8;
+    }
+}
+
+// Consumes 'n' bits. Returns 0 if that reads past the end of the input.
+static int consumeBits(BitReader* br, int n) {
+    br->acc <<= n;
+    br->count -= n;
+    return br->count >= 0;
+}
+
+// --- Decoders ---
+
+// Walks the tree from the root to a leaf one bit at a time for every symbol.
+// Returns the number of symbols written to 'dest'; sets *ok to 0 on
+// truncated or corrupt input.
+static size_t decodeTreeSymbols(BitReader* br, const HuffTree* tree, unsigned char* dest, size_t count, int* ok) {
+    const Node* nodes = tree->nodes;
+    for (size_t i = 0; i < count; ++i) {
+        unsigned short node = tree->root;
+        while (!isLeaf(&nodes[node])) {
+            if (br->count <= 0) refillBits(br);
+            // Check the current bit
+            node = (br->acc >> 63) ? nodes[node].right : nodes[node].left;
+            if (!consumeBits(br, 1) || node == HUFF_TREE_NONE) {
+                *ok = 0;
+                return i;
+            }
+        }
+        dest[i] = nodes[node].data;
+    }
+    return count;
+}
+
+// Decodes with multi-bit lookups: each primary probe on the next
+// DECODE_PRIMARY_BITS bits emits one or two whole symbols.
+// If a probe yields two symbols where only one fits, the call ends early,
+// unless 'last' is set: then the second symbol is padding after the end of
+// the stream. Returns the number of symbols written to 'dest'; sets *ok to
+// 0 on truncated or corrupt input.
+static size_t decodeTableSymbols(BitReader* br, const DecodeTable* table, unsigned char* dest,
+                                 size_t count, int last, int* ok) {
+    size_t i = 0;
+
+    // Every code fits the primary table (e.g. with setMaxCodeLength(11)):
+    // a refill leaves at least 57 bits, enough for five probes of at most
+    // DECODE_PRIMARY_BITS each, so they need no refill or end-of-input
+    // checks. Corrupt input and the end of the stream go to the loop below.
+    if (table->secondaryCount == 0 && table->escapeCount == 0) {
+        while (count - i >= 10) {
+            refillBits(br);
+            if (br->count < 5 * DECODE_PRIMARY_BITS) break;
+            int k;
+            for (k = 0; k < 5; ++k) {
+                DecodeEntry e = table->primary[br->acc >> (64 - DECODE_PRIMARY_BITS)];
+                if (e.count == DECODE_INVALID) break;
+                dest[i] = (unsigned char)e.symbols;
+                dest[i + 1] = (unsigned char)(e.symbols >> 8);
+                i += e.count;
+                br->acc <<= e.bits;
+                br->count -= e.bits;
+            }
+            if (k < 5) break;
+        }
+    }
+
+    while (i < count) {
+        refillBits(br);
+
+        DecodeEntry e = table->primary[br->acc >> (64 - DECODE_PRIMARY_BITS)];
+        if (e.count == 2) {
+            if (count - i < 2) {
+                if (!last) return i;
+                // Only the first symbol is data
+                dest[i++] = (unsigned char)e.symbols;
+                consumeBits(br, table->pairFirstBits[e.symbols & 0xFF]);
+                break;
+            }
+            dest[i++] = (unsigned char)e.symbols;
+            dest[i++] = (unsigned char)(e.symbols >> 8);
+        } else if (e.count == 1) {
+            dest[i++] = (unsigned char)e.symbols;
+        } else if (e.count == DECODE_LINK) {
+            if (!consumeBits(br, DECODE_PRIMARY_BITS)) break;
+            int width = e.bits;
+            e = table->secondary[table->secondaryOffset[e.symbols] + (br->acc >> (64 - width))];
+            if (e.count == 1) {
+                dest[i++] = (unsigned char)e.symbols;
+            } else if (e.count == DECODE_ESCAPE) {
+                // Rare very long code: finish it on the tree
+                const Node* nodes = table->tree->nodes;
+                unsigned short node = table->escapes[e.symbols];
+                if (!consumeBits(br, e.bits)) break;
+                while (node != HUFF_TREE_NONE && !isLeaf(&nodes[node])) {
+                    if (br->count <= 0) refillBits(br);
+                    node = (br->acc >> 63) ? nodes[node].right : nodes[node].left;
+                    if (!consumeBits(br, 1)) node = HUFF_TREE_NONE;
+                }
+                if (node == HUFF_TREE_NONE) break;
+                dest[i++] = nodes[node].data;
+                continue;
+            } else {
+                break;
+            }
+        } else {
+            break;
+        }
+
+        if (!consumeBits(br, e.bits)) break;
+    }
+
+    // Also fails if the last symbols ran past the end of the input
+    if (i < count || br->count < 0) *ok = 0;
+    return i;
+}
+
+// Decodes the code at the front of 'br' into out[0..2) if it resolves in
+// the primary or a secondary table, without refilling. Returns the number
+// of symbols, or 0 (consuming nothing) for escapes and corrupt input.
+static inline int probeTable(BitReader* br, const DecodeTable* table, unsigned char* out) {
+    DecodeEntry e = table->primary[br->acc >> (64 - DECODE_PRIMARY_BITS)];
+    int bits = e.bits;
+    if (e.count == DECODE_LINK) {
+        // Look the rest of the code up before consuming anything
+        e = table->secondary[table->secondaryOffset[e.symbols] + ((br->acc << DECODE_PRIMARY_BITS) >> (64 - bits))];
+        bits = DECODE_PRIMARY_BITS + e.bits;
+    }
+    if (e.count != 1 && e.count != 2) return 0;
+    out[0] = (unsigned char)e.symbols;
+    out[1] = (unsigned char)(e.symbols >> 8);
+    consumeBits(br, bits);
+    return e.count;
+}
+
+// Decodes the four streams of an interleaved block, stream s into
+// dest[s][0..count[s]). A single stream is a chain of dependent loads: the
+// next lookup needs the length of the current code. Taking turns between
+// the streams gives the CPU four independent chains to overlap.
+// A refill leaves at least 57 bits, enough for two codes of up to
+// DECODE_PRIMARY_BITS + DECODE_SECONDARY_BITS bits. Rounds run in batches
+// small enough that no stream can reach the end of its segment; the ends,
+// codes that escape to the tree and corrupt input are left to
+// decodeTableSymbols. Sets *ok to 0 on truncated or corrupt input.
+static void decodeInterleavedSymbols(BitReader br[HUFF_INTERLEAVED_STREAMS], const DecodeTable* table,
+                                     unsigned char* dest[HUFF_INTERLEAVED_STREAMS],
+                                     const size_t count[HUFF_INTERLEAVED_STREAMS], int* ok) {
+    size_t done[HUFF_INTERLEAVED_STREAMS] = {0};
+    int lockstep = 1;
+    while (lockstep) {
+        size_t rounds = SIZE_MAX;
+        for (int s = 0; s < HUFF_INTERLEAVED_STREAMS; ++s) {
+            size_t left = (count[s] - done[s]) / 4; // Two probes of up to two symbols
+            if (left < rounds) rounds = left;
+        }
+        if (rounds < 4) break;
+
+        for (size_t r = 0; lockstep && r < rounds; ++r) {
+            for (int s = 0; s < HUFF_INTERLEAVED_STREAMS; ++s) refillBits(&br[s]);
+            for (int k = 0; k < 2; ++k) {
+                for (int s = 0; s < HUFF_INTERLEAVED_STREAMS; ++s) {
+                    int n = probeTable(&br[s], table, dest[s] + done[s]);
+                    if (n == 0) lockstep = 0;
+                    done[s] += n;
+                }
+            }
+        }
+    }
+
+    for (int s = 0; s < HUFF_INTERLEAVED_STREAMS; ++s) {
+        decodeTableSymbols(&br[s], table, dest[s] + done[s], count[s] - done[s], 1, ok);
+    }
+}
+
+// Decodes 'total' symbols straight into 'dest' when the output is mapped,
+// otherwise through a buffer into 'out'. The table decoder runs if 'table'
+// is set, otherwise the tree walker on 'tree'. Returns the number of
+// symbols written; sets *ok to 0 on truncated or corrupt input, or if a
+// write fails.
+static unsigned long long decodeToOutput(BitReader* br, const DecodeTable* table, const HuffTree* tree,
+                                         unsigned char* dest, FILE* out,
+                                         unsigned long long total, int* ok) {
+    if (dest) {
+        return table ? decodeTableSymbols(br, table, dest, (size_t)total, 1, ok)
+                     : decodeTreeSymbols(br, tree, dest, (size_t)total, ok);
+    }
+
+    unsigned char* buffer = (unsigned char*)malloc(IO_BUFFER_SIZE);
+    if (!buffer) {
+        perror("malloc error (decodeToOutput)");
+        *ok = 0;
+        return 0;
+    }
+
+    unsigned long long done = 0;
+    while (*ok && done < total) {
+        size_t want = (total - done < IO_BUFFER_SIZE) ? (size_t)(total - done) : IO_BUFFER_SIZE;
+        int last = (done + want == total);
+        size_t n = table ? decodeTableSymbols(br, table, buffer, want, last, ok)
+                         : decodeTreeSymbols(br, tree, buffer, want, ok);
+        if (writeBuffer(buffer, n, out) != n) *ok = 0;
+        done += n;
+    }
+
+    free(buffer);
+    return done;
+}
+
+// Builds what the selected decoder needs for a single-stream file, from
+// the legacy frequency table or from the code lengths (the other one is
+// NULL): *table for the table decoder, *tree for the tree walker (legacy
+// files with long codes need both). Both are released with free() and
+// releaseDecodeTable(). Returns 0 on success, -1 on error.
+static int buildStreamDecoder(const unsigned long long* freqTable, const unsigned char* lengths,
+                              HuffTree** tree, DecodeTable** table) {
+    *tree = NULL;
+    *table = NULL;
+    if (freqTable || decoderMode == DECODER_TREE) {
+        *tree = (HuffTree*)malloc(sizeof(HuffTree));
+        if (!*tree) {
+            perror("malloc error (buildStreamDecoder)");
+            return -1;
+        }
+    }
+    if (freqTable) {
+        if (buildHuffmanTree(freqTable, *tree) != 0) {
+            fprintf(stderr, "Error: Failed to rebuild Huffman tree.\n");
+            free(*tree);
+            *tree = NULL;
+            return -1;
+        }
+        if (decoderMode == DECODER_TABLE && !(*table = buildDecodeTable(*tree))) {
+            free(*tree);
+            *tree = NULL;
+            return -1;
+        }
+        return 0;
+    }
+
+    HuffCode codes[NUM_CHARS];
+    assignCanonicalCodes(lengths, codes);
+    if (decoderMode == DECODER_TABLE) {
+        if (!(*table = acquireDecodeTable(codes))) return -1;
+    } else if (buildCanonicalTree(codes, *tree) != 0) {
+        fprintf(stderr, "Error: Failed to rebuild Huffman tree.\n");
+        free(*tree);
+        *tree = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Reads the code description of a single-stream file ('in' positioned
+// right after the char count) and builds the decoder for it (see
+// buildStreamDecoder). Returns 0 on success, -1 on error.
+static int readStreamCodes(FILE* in, unsigned int magic, HuffTree** tree, DecodeTable** table, HuffStats* stats) {
+    if (magic == MAGIC_NUMBER) {
+        unsigned long long freqTable[NUM_CHARS];
+        if (fread(freqTable, sizeof(unsigned long long), NUM_CHARS, in) != NUM_CHARS) {
+            fprintf(stderr, "Error: Failed to read frequency table.\n");
+            return -1;
+        }
+        return buildStreamDecoder(freqTable, NULL, tree, table);
+    }
+
+    unsigned char lengths[NUM_CHARS];
+    if (magic == MAGIC_NUMBER_STATIC) {
+        unsigned id;
+        if (fread(&id, sizeof(unsigned), 1, in) != 1) {
+            fprintf(stderr, "Error: Failed to read dictionary ID.\n");
+            return -1;
+        }
+        if (findDictionary(id, lengths, NULL) != 0) {
+            fprintf(stderr, "Error: Unknown dictionary %u.\n", id);
+            return -1;
+        }
+    } else if (readCodeLengths(in, lengths) != 0) {
+        fprintf(stderr, "Error: Failed to read code lengths.\n");
+        return -1;
+    }
+    recordBlockStats(stats, NULL, lengths, 0, 0); // The symbols are added once decoded
+    return buildStreamDecoder(NULL, lengths, tree, table);
+}
+
+// --- Block Container ---
+
+static void writeBlockHeader(unsigned char* dest, int type, unsigned rawSize, unsigned payloadSize) {
+    dest[0] = (unsigned char)type;
+    memcpy(dest + 1, &rawSize, sizeof(unsigned));
+    memcpy(dest + 5, &payloadSize, sizeof(unsigned));
+}
+
+static void readBlockHeader(const unsigned char* src, int* type, unsigned* rawSize, unsigned* payloadSize) {
+    *type = src[0];
+    memcpy(rawSize, src + 1, sizeof(unsigned));
+    memcpy(payloadSize, src + 5, sizeof(unsigned));
+}
+
+static void writeIndexEntry(unsigned char* dest, unsigned long long offset,
+                            unsigned compressedSize, unsigned rawSize) {
+    memcpy(dest, &offset, sizeof(unsigned long long));
+    memcpy(dest + 8, &compressedSize, sizeof(unsigned));
+    memcpy(dest + 12, &rawSize, sizeof(unsigned));
+}
+
+// A block's place in the file and in the original data
+typedef struct BlockIndexEntry {
+    unsigned long long offset;    // File offset of the block header
+    unsigned long long rawOffset; // Offset of the block's first byte in the original data
+    unsigned compressedSize;      // Block header plus payload
+    unsigned rawSize;
+} BlockIndexEntry;
+
+// Reads and checks the block index at the end of a mapped container.
+// Returns a malloc'd array and sets *blockCount, or returns NULL if the
+// file has no usable index.
+static BlockIndexEntry* readBlockIndex(const InputMap* map, unsigned long long originalCharCount,
+                                       unsigned long long* blockCount) {
+    if (map->size < INDEX_FOOTER_SIZE) return NULL;
+    const unsigned char* footer = map->data + map->size - INDEX_FOOTER_SIZE;
+    unsigned long long indexOffset, blocks;
+    unsigned magic;
+    memcpy(&indexOffset, footer, sizeof(unsigned long long));
+    memcpy(&blocks, footer + 8, sizeof(unsigned long long));
+    memcpy(&magic, footer + 16, sizeof(unsigned));
+    if (magic != MAGIC_NUMBER_INDEX || indexOffset > map->size - INDEX_FOOTER_SIZE ||
+        blocks != (map->size - INDEX_FOOTER_SIZE - indexOffset) / INDEX_ENTRY_SIZE) {
+        return NULL;
+    }
+
+    // Short of memory, the blocks are read by following their headers
+    BlockIndexEntry* index = (BlockIndexEntry*)malloc((size_t)blocks * sizeof(BlockIndexEntry) + 1);
+    if (!index) return NULL;
+    const unsigned char* p = map->data + indexOffset;
+    unsigned long long rawOffset = 0;
+    for (unsigned long long i = 0; i < blocks; ++i, p += INDEX_ENTRY_SIZE) {
+        BlockIndexEntry* e = &index[i];
+        memcpy(&e->offset, p, sizeof(unsigned long long));
+        memcpy(&e->compressedSize, p + 8, sizeof(unsigned));
+        memcpy(&e->rawSize, p + 12, sizeof(unsigned));
+        e->rawOffset = rawOffset;
+        rawOffset += e->rawSize;
+        if (e->compressedSize < BLOCK_HEADER_SIZE || e->offset > indexOffset ||
+            e->compressedSize > indexOffset - e->offset || e->rawSize > originalCharCount) {
+            free(index);
+            return NULL;
+        }
+    }
+    if (rawOffset != originalCharCount) {
+        free(index);
+        return NULL;
+    }
+
+    *blockCount = blocks;
+    return index;
+}
+
+// Adds up the raw sizes in the block headers of data[0..size) (the blocks
+// of a container, up to its end marker). Returns SIZE_UNKNOWN if the
+// blocks are truncated or one is larger than HUFF_MAX_BLOCK_SIZE.
+static unsigned long long sumBlockSizes(const unsigned char* data, size_t size) {
+    unsigned long long total = 0;
+    size_t pos = 0;
+    for (;;) {
+        if (size - pos < BLOCK_HEADER_SIZE) return SIZE_UNKNOWN;
+        int type;
+        unsigned rawSize, payloadSize;
+        readBlockHeader(data + pos, &type, &rawSize, &payloadSize);
+        if (type == BLOCK_TYPE_END) return total;
+        if (rawSize > HUFF_MAX_BLOCK_SIZE) return SIZE_UNKNOWN;
+        pos += BLOCK_HEADER_SIZE;
+        if (payloadSize > size - pos) return SIZE_UNKNOWN;
+        pos += payloadSize;
+        total += rawSize;
+    }
+}
+
+// Replaces a streamed container's unknown char count with the sum of its
+// block sizes, if the file can be mapped
+static void resolveStreamSize(FILE* in, unsigned long long* total) {
+    if (*total != SIZE_UNKNOWN) return;
+    InputMap map;
+    if (mapFile(fileno(in), &map) != 0) return;
+    if (map.size >= BLOCKS_START) *total = sumBlockSizes(map.data + BLOCKS_START, map.size - BLOCKS_START);
+    releaseInput(&map);
+}
+
+// Size of each of the four segments of an interleaved block; the last
+// one takes what is left
+static size_t interleavedSegment(size_t rawSize) {
+    return (rawSize + HUFF_INTERLEAVED_STREAMS - 1) / HUFF_INTERLEAVED_STREAMS;
+}
+
+// Appends a stored or RLE block of data[0..size)
+static void appendRawBlock(BitWriter* bw, int type, const unsigned char* data, size_t size) {
+    unsigned payloadSize = (type == BLOCK_TYPE_RLE) ? 1 : (unsigned)size;
+    unsigned char header[BLOCK_HEADER_SIZE];
+    writeBlockHeader(header, type, (unsigned)size, payloadSize);
+    putBytes(bw, header, BLOCK_HEADER_SIZE);
+    putBytes(bw, data, payloadSize);
+}
+
+// Appends one block (header, code lengths, bit stream) to an in-memory
+// writer. With four streams, each quarter of the block is coded to its own
+// byte-aligned stream, and a jump table of stream sizes follows the code
+// lengths.
+static void appendBlock(BitWriter* bw, const unsigned char* data, size_t size, HuffStats* stats) {
+    StageClock clock;
+    startClock(&clock, stats);
+    unsigned long long freqTable[NUM_CHARS] = {0};
+    countFrequencies(data, size, freqTable);
+    lapClock(&clock, HUFF_STAGE_HISTOGRAM);
+
+    // One repeated byte or near-random data: no tree at all
+    int type = chooseBlockType(freqTable, size);
+    if (type != BLOCK_TYPE_HUFFMAN) {
+        appendRawBlock(bw, type, data, size);
+        lapClock(&clock, HUFF_STAGE_BITS);
+        recordBlockStats(stats, freqTable, NULL, size, (type == BLOCK_TYPE_RLE) ? 8 : size * 8ull);
+        return;
+    }
+
+    unsigned char lengths[NUM_CHARS];
+    HuffCode codes[NUM_CHARS];
+    unsigned long long bits = buildEncoderCodes(freqTable, lengths, codes, &clock); // Exact output size
+    int interleaved = (streamCount == HUFF_INTERLEAVED_STREAMS && size >= INTERLEAVE_MIN_SIZE);
+
+    reserveBytes(bw, BLOCK_HEADER_SIZE + CODE_LENGTHS_MAX_SIZE + JUMP_TABLE_SIZE + (size_t)(bits / 8) + 40);
+    if (bw->failed) return; // Out of memory: the output is dropped anyway
+    size_t start = bw->pos;
+    bw->pos += BLOCK_HEADER_SIZE;
+    bw->pos += packCodeLengths(lengths, bw->buffer + bw->pos);
+    lapClock(&clock, HUFF_STAGE_HEADER);
+
+    // Small blocks whose code lengths cost more than the coding saves
+    size_t headerSize = bw->pos - start - BLOCK_HEADER_SIZE + (interleaved ? JUMP_TABLE_SIZE : 0);
+    if (headerSize + (bits + 7) / 8 >= size) {
+        bw->pos = start;
+        appendRawBlock(bw, BLOCK_TYPE_STORED, data, size);
+        lapClock(&clock, HUFF_STAGE_BITS);
+        recordBlockStats(stats, freqTable, NULL, size, size * 8ull);
+        return;
+    }
+    if (interleaved) {
+        size_t jump = bw->pos; // An offset: finishBits may move the buffer
+        size_t segment = interleavedSegment(size);
+        bw->pos += JUMP_TABLE_SIZE;
+        for (int s = 0; s < HUFF_INTERLEAVED_STREAMS; ++s) {
+            size_t streamStart = bw->pos;
+            size_t from = s * segment;
+            encodeSymbols(bw, data + from, (s < HUFF_INTERLEAVED_STREAMS - 1) ? segment : size - from, codes);
+            finishBits(bw);
+            if (s < HUFF_INTERLEAVED_STREAMS - 1) {
+                unsigned streamSize = (unsigned)(bw->pos - streamStart);
+                memcpy(bw->buffer + jump + s * sizeof(unsigned), &streamSize, sizeof(unsigned));
+            }
+        }
+    } else {
+        encodeSymbols(bw, data, size, codes);
+        finishBits(bw);
+    }
+
+    writeBlockHeader(bw->buffer + start, interleaved ? BLOCK_TYPE_HUFFMAN4 : BLOCK_TYPE_HUFFMAN, (unsigned)size,
+                     (unsigned)(bw->pos - start - BLOCK_HEADER_SIZE));
+    lapClock(&clock, HUFF_STAGE_BITS);
+    recordBlockStats(stats, freqTable, lengths, size, bits);
+}
+
+// Encodes one block into a malloc'd buffer. Returns the buffer and its
+// size in *encodedSize, or NULL if memory runs out.
+static unsigned char* encodeBlock(const unsigned char* data, size_t size, size_t* encodedSize,
+                                  HuffStats* stats) {
+    BitWriter bw;
+    initBitWriterMemory(&bw, BLOCK_HEADER_SIZE + CODE_LENGTHS_MAX_SIZE + size + 16);
+    appendBlock(&bw, data, size, stats);
+    if (bw.failed) {
+        freeBitWriter(&bw);
+        return NULL;
+    }
+    *encodedSize = bw.pos;
+    return bw.buffer;
+}
+
+// Decodes the streams of a BLOCK_TYPE_HUFFMAN4 payload, 'src' pointing at
+// the jump table. Returns 0 on success, -1 on corrupt input.
+static int decodeInterleavedBlock(const unsigned char* src, size_t size, const HuffCode codes[NUM_CHARS],
+                                  unsigned char* dest, size_t rawSize) {
+    if (size < JUMP_TABLE_SIZE) return -1;
+
+    // 1. Find the streams and their segments of the output
+    BitReader br[HUFF_INTERLEAVED_STREAMS];
+    unsigned char* segments[HUFF_INTERLEAVED_STREAMS];
+    size_t counts[HUFF_INTERLEAVED_STREAMS];
+    size_t segment = interleavedSegment(rawSize);
+    size_t pos = JUMP_TABLE_SIZE;
+    for (int s = 0; s < HUFF_INTERLEAVED_STREAMS; ++s) {
+        size_t streamSize = size - pos;
+        if (s < HUFF_INTERLEAVED_STREAMS - 1) {
+            unsigned jump;
+            memcpy(&jump, src + s * sizeof(unsigned), sizeof(unsigned));
+            if (jump > size - pos) return -1;
+            streamSize = jump;
+        }
+        size_t from = s * segment < rawSize ? s * segment : rawSize;
+        initBitReaderMemory(&br[s], src + pos, streamSize);
+        segments[s] = dest + from;
+        counts[s] = (s < HUFF_INTERLEAVED_STREAMS - 1 && rawSize - from > segment) ? segment : rawSize - from;
+        pos += streamSize;
+    }
+
+    // 2. Decode them
+    int ok = 1;
+    if (decoderMode == DECODER_TABLE) {
+        DecodeTable* table = acquireDecodeTable(codes);
+        if (!table) return -1;
+        decodeInterleavedSymbols(br, table, segments, counts, &ok);
+        releaseDecodeTable(table);
+    } else {
+        HuffTree tree;
+        if (buildCanonicalTree(codes, &tree) != 0) return -1;
+        for (int s = 0; s < HUFF_INTERLEAVED_STREAMS; ++s) {
+            decodeTreeSymbols(&br[s], &tree, segments[s], counts[s], &ok);
+        }
+    }
+    return ok ? 0 : -1;
+}
+
+// Decodes a block payload into dest[0..rawSize), recording it in 'stats'
+// if set. Safe to call from several threads at once. Returns 0 on
+// success, -1 on corrupt input.
+static int decodeBlock(int type, const unsigned char* payload, size_t payloadSize,
+                       unsigned char* dest, size_t rawSize, HuffStats* stats) {
+    StageClock clock;
+    startClock(&clock, stats);
+    if (type == BLOCK_TYPE_STORED || type == BLOCK_TYPE_RLE) {
+        if (payloadSize != ((type == BLOCK_TYPE_RLE) ? 1 : rawSize)) return -1;
+        if (type == BLOCK_TYPE_RLE) {
+            memset(dest, payload[0], rawSize);
+        } else {
+            memcpy(dest, payload, rawSize);
+        }
+        lapClock(&clock, HUFF_STAGE_BITS);
+        recordBlockStats(stats, NULL, NULL, rawSize, payloadSize * 8ull);
+        return 0;
+    }
+    if (type != BLOCK_TYPE_HUFFMAN && type != BLOCK_TYPE_HUFFMAN4) return -1;
+
+    unsigned char lengths[NUM_CHARS];
+    size_t n = unpackCodeLengths(payload, payloadSize, lengths);
+    if (n == 0) return -1;
+    lapClock(&clock, HUFF_STAGE_HEADER);
+    HuffCode codes[NUM_CHARS];
+    assignCanonicalCodes(lengths, codes);
+    lapClock(&clock, HUFF_STAGE_CODES);
+    if (type == BLOCK_TYPE_HUFFMAN4) {
+        int rc = decodeInterleavedBlock(payload + n, payloadSize - n, codes, dest, rawSize);
+        lapClock(&clock, HUFF_STAGE_BITS);
+        if (rc == 0 && payloadSize - n >= JUMP_TABLE_SIZE) {
+            recordBlockStats(stats, NULL, lengths, rawSize, (payloadSize - n - JUMP_TABLE_SIZE) * 8ull);
+        }
+        return rc;
+    }
+
+    BitReader br;
+    initBitReaderMemory(&br, payload + n, payloadSize - n);
+    int ok = 1;
+    if (decoderMode == DECODER_TABLE) {
+        DecodeTable* table = acquireDecodeTable(codes);
+        if (!table) return -1;
+        decodeTableSymbols(&br, table, dest, rawSize, 1, &ok);
+        releaseDecodeTable(table);
+    } else {
+        HuffTree tree;
+        if (buildCanonicalTree(codes, &tree) != 0) return -1;
+        decodeTreeSymbols(&br, &tree, dest, rawSize, &ok);
+    }
+    lapClock(&clock, HUFF_STAGE_BITS);
+    if (ok) recordBlockStats(stats, NULL, lengths, rawSize, (payloadSize - n) * 8ull);
+    return ok ? 0 : -1;
+}
+
+// One block of work for the compression pool
+typedef struct BlockJob {
+    const unsigned char* data;
+    size_t size;
+    unsigned char* encoded;
+    size_t encodedSize;
+    HuffStats* stats; // NULL, or the job's own stats
+    HuffStats jobStats;
+} BlockJob;
+
+static void runBlockJob(void* arg) {
+    BlockJob* job = (BlockJob*)arg;
+    job->encoded = encodeBlock(job->data, job->size, &job->encodedSize, job->stats);
+}
+
+// Writes the block container for data[0..size) to 'bw', in blocks of
+// 'blockBytes'. Blocks are encoded on a thread pool a batch at a time and
+// written in order. Running out of memory fails the writer.
+static void compressBlocks(const unsigned char* data, unsigned long long size, size_t blockBytes, BitWriter* bw) {
+    unsigned nominal = (unsigned)blockBytes;
+    putBytes(bw, &MAGIC_NUMBER_BLOCKS, sizeof(unsigned int));
+    putBytes(bw, &size, sizeof(unsigned long long));
+    putBytes(bw, &nominal, sizeof(unsigned));
+
+    unsigned long long blocks = (size + blockBytes - 1) / blockBytes;
+    ThreadPool* pool = acquirePool(blocks);
+    size_t batch = (size_t)poolSize(pool) * BLOCKS_PER_WORKER;
+    BlockJob* jobs = (BlockJob*)malloc(batch * sizeof(BlockJob));
+    unsigned char* index = (unsigned char*)malloc((size_t)blocks * INDEX_ENTRY_SIZE + 1);
+    unsigned long long offset = sizeof(unsigned int) + sizeof(unsigned long long) + sizeof(unsigned);
+    if (!jobs || !index) {
+        perror("malloc error (compressBlocks)");
+        failWriter(bw);
+        free(index);
+        free(jobs);
+        releasePool(pool);
+        return;
+    }
+
+    for (unsigned long long first = 0; first < blocks; first += batch) {
+        size_t n = (blocks - first < batch) ? (size_t)(blocks - first) : batch;
+        for (size_t k = 0; k < n; ++k) {
+            unsigned long long offset = (first + k) * blockBytes;
+            jobs[k].data = data + offset;
+            jobs[k].size = (size - offset < blockBytes) ? (size_t)(size - offset) : blockBytes;
+            jobs[k].stats = statsTarget ? &jobs[k].jobStats : NULL;
+            if (statsTarget) memset(&jobs[k].jobStats, 0, sizeof(HuffStats));
+            submitPoolJob(pool, runBlockJob, &jobs[k]);
+        }
+        waitForPoolJobs(pool);
+
+        for (size_t k = 0; k < n; ++k) {
+            if (jobs[k].stats) mergeStats(statsTarget, jobs[k].stats);
+            if (!jobs[k].encoded) {
+                failWriter(bw);
+                continue;
+            }
+            putBytes(bw, jobs[k].encoded, jobs[k].encodedSize);
+            writeIndexEntry(index + (first + k) * INDEX_ENTRY_SIZE, offset,
+                            (unsigned)jobs[k].encodedSize, (unsigned)jobs[k].size);
+            offset += jobs[k].encodedSize;
+            free(jobs[k].encoded);
+        }
+    }
+
+    unsigned char end[BLOCK_HEADER_SIZE];
+    writeBlockHeader(end, BLOCK_TYPE_END, 0, 0);
+    putBytes(bw, end, BLOCK_HEADER_SIZE);
+    offset += BLOCK_HEADER_SIZE;
+
+    // Block index and footer, for parallel and random-access reads
+    putBytes(bw, index, (size_t)blocks * INDEX_ENTRY_SIZE);
+    putBytes(bw, &offset, sizeof(unsigned long long));
+    putBytes(bw, &blocks, sizeof(unsigned long long));
+    putBytes(bw, &MAGIC_NUMBER_INDEX, sizeof(unsigned int));
+
+    free(index);
+    free(jobs);
+    releasePool(pool);
+}
+
+// Where a container's blocks are read from: a mapping of the whole file,
+// or a stream read one block at a time.
+typedef struct BlockInput {
+    FILE* in;
+    InputMap map;
+    size_t pos;
+    unsigned char* buffer;
+    size_t bufferSize;
+} BlockInput;
+
+// Returns the next 'n' bytes, or NULL if the input ends first (or they
+// do not fit in memory)
+static const unsigned char* readBlockInput(BlockInput* bi, size_t n) {
+    if (bi->in == NULL) {
+        if (n > bi->map.size - bi->pos) return NULL;
+        const unsigned char* p = bi->map.data + bi->pos;
+        bi->pos += n;
+        return p;
+    }
+    if (n > bi->bufferSize) {
+        unsigned char* buffer = (unsigned char*)realloc(bi->buffer, n);
+        if (!buffer) {
+            perror("malloc error (readBlockInput)");
+            return NULL;
+        }
+        bi->buffer = buffer;
+        bi->bufferSize = n;
+    }
+    return readBuffer(bi->buffer, n, bi->in) == n ? bi->buffer : NULL;
+}
+
+// One block of work for the decompression pool
+typedef struct DecodeJob {
+    const unsigned char* block; // Block header followed by its payload
+    size_t blockSize;
+    unsigned char* dest;
+    size_t rawSize;
+    int failed;
+    HuffStats* stats; // NULL, or the job's own stats
+    HuffStats jobStats;
+} DecodeJob;
+
+static void runDecodeJob(void* arg) {
+    DecodeJob* job = (DecodeJob*)arg;
+    int type;
+    unsigned rawSize, payloadSize;
+    readBlockHeader(job->block, &type, &rawSize, &payloadSize);
+    job->failed = rawSize != job->rawSize || payloadSize != job->blockSize - BLOCK_HEADER_SIZE ||
+                  decodeBlock(type, job->block + BLOCK_HEADER_SIZE, payloadSize, job->dest, rawSize,
+                              job->stats) != 0;
+}
+
+// Decodes indexed blocks on a thread pool. With a mapped output every
+// worker writes straight to its block's offset; otherwise blocks are
+// decoded a batch at a time into a scratch buffer and written in order.
+// Returns the number of bytes written before the first failure (corrupt
+// input or a failed write).
+static unsigned long long decodeIndexedBlocks(const InputMap* map, const BlockIndexEntry* index,
+                                              unsigned long long blocks, unsigned char* dest,
+                                              FILE* out, int* ok) {
+    ThreadPool* pool = acquirePool(blocks);
+    size_t batch = dest ? (size_t)blocks : (size_t)poolSize(pool) * BLOCKS_PER_WORKER;
+    if (batch == 0) batch = 1;
+    DecodeJob* jobs = (DecodeJob*)malloc(batch * sizeof(DecodeJob));
+    unsigned char* scratch = NULL;
+    if (!jobs) {
+        perror("malloc error (decodeIndexedBlocks)");
+        releasePool(pool);
+        *ok = 0;
+        return 0;
+    }
+
+    unsigned long long written = 0;
+    for (unsigned long long first = 0; *ok && first < blocks; first += batch) {
+        size_t n = (blocks - first < batch) ? (size_t)(blocks - first) : batch;
+        unsigned long long batchStart = index[first].rawOffset;
+        if (!dest) {
+            unsigned long long batchRaw = index[first + n - 1].rawOffset + index[first + n - 1].rawSize - batchStart;
+            free(scratch);
+            scratch = (unsigned char*)malloc((size_t)batchRaw + 1);
+            if (!scratch) {
+                perror("malloc error (decodeIndexedBlocks)");
+                *ok = 0;
+                break;
+            }
+        }
+
+        for (size_t k = 0; k < n; ++k) {
+            const BlockIndexEntry* e = &index[first + k];
+            jobs[k].block = map->data + e->offset;
+            jobs[k].blockSize = e->compressedSize;
+            jobs[k].dest = dest ? dest + e->rawOffset : scratch + (e->rawOffset - batchStart);
+            jobs[k].rawSize = e->rawSize;
+            jobs[k].failed = 0;
+            jobs[k].stats = statsTarget ? &jobs[k].jobStats : NULL;
+            if (statsTarget) memset(&jobs[k].jobStats, 0, sizeof(HuffStats));
+            submitPoolJob(pool, runDecodeJob, &jobs[k]);
+        }
+        waitForPoolJobs(pool);
+
+        for (size_t k = 0; k < n; ++k) {
+            if (jobs[k].stats) mergeStats(statsTarget, jobs[k].stats);
+            if (jobs[k].failed) {
+                *ok = 0;
+                break;
+            }
+            if (!dest && writeBuffer(jobs[k].dest, jobs[k].rawSize, out) != jobs[k].rawSize) {
+                *ok = 0;
+                break;
+            }
+            written += jobs[k].rawSize;
+        }
+    }
+
+    free(scratch);
+    free(jobs);
+    releasePool(pool);
+    return written;
+}
+
+// Decodes blocks one after another by following the block headers (used
+// for streams and for containers without an index). Returns the number
+// of bytes written before the first failure (corrupt input or a failed
+// write).
+static unsigned long long decodeSequentialBlocks(BlockInput* src, unsigned long long originalCharCount,
+                                                 unsigned char* dest, FILE* out, int* ok) {
+    unsigned long long written = 0;
+    unsigned char* scratch = NULL;
+    size_t scratchSize = 0;
+    for (;;) {
+        const unsigned char* header = readBlockInput(src, BLOCK_HEADER_SIZE);
+        if (!header) { *ok = 0; break; }
+        int type;
+        unsigned rawSize, payloadSize;
+        readBlockHeader(header, &type, &rawSize, &payloadSize);
+        if (type == BLOCK_TYPE_END) break;
+        if (rawSize > originalCharCount - written) { *ok = 0; break; }
+
+        const unsigned char* payload = readBlockInput(src, payloadSize);
+        if (!payload) { *ok = 0; break; }
+
+        unsigned char* target;
+        if (dest) {
+            target = dest + written;
+        } else {
+            if (rawSize > scratchSize) {
+                unsigned char* grown = (unsigned char*)realloc(scratch, rawSize);
+                if (!grown) {
+                    perror("malloc error (decodeSequentialBlocks)");
+                    *ok = 0;
+                    break;
+                }
+                scratch = grown;
+                scratchSize = rawSize;
+            }
+            target = scratch;
+        }
+        if (decodeBlock(type, payload, payloadSize, target, rawSize, statsTarget) != 0) { *ok = 0; break; }
+        if (!dest && writeBuffer(target, rawSize, out) != rawSize) { *ok = 0; break; }
+        written += rawSize;
+    }
+    free(scratch);
+    return written;
+}
+
+// Decodes the blocks of a container, 'in' being positioned right after
+// the char count (which may be SIZE_UNKNOWN for a streamed container read
+// from a pipe). Returns 0 on success, -1 on error.
+static int decompressBlocks(FILE* in, const char* outputPath, unsigned long long originalCharCount) {
+    unsigned nominal;
+    if (fread(&nominal, sizeof(unsigned), 1, in) != 1) {
+        fprintf(stderr, "Error: Failed to read header.\n");
+        return -1;
+    }
+
+    // 1. Read blocks out of a mapping of the input if possible; with a
+    //    block index they can be decoded in parallel
+    BlockInput src = {in, {NULL, 0, 0}, 0, NULL, 0};
+    BlockIndexEntry* index = NULL;
+    unsigned long long blocks = 0;
+    long dataStart = ftell(in);
+    int known = (originalCharCount != SIZE_UNKNOWN);
+    if (dataStart >= 0 && mapFile(fileno(in), &src.map) == 0 && (size_t)dataStart <= src.map.size) {
+        src.in = NULL;
+        src.pos = (size_t)dataStart;
+        if (known) index = readBlockIndex(&src.map, originalCharCount, &blocks);
+        // Without an index, the block headers must add up to the char count
+        // before the output is sized from it
+        if (known && !index && sumBlockSizes(src.map.data + src.pos, src.map.size - src.pos) != originalCharCount) {
+            fprintf(stderr, "Error: Compressed data is truncated or corrupted.\n");
+            releaseInput(&src.map);
+            return -1;
+        }
+    }
+
+    // 2. Open output file: mapped at its final size when possible
+    OutputMap outMap;
+    FILE* out = NULL;
+    int mappedOut = known && (mapOutputFile(outputPath, originalCharCount, &outMap) == 0);
+    if (!mappedOut) {
+        out = fopen(outputPath, "wb");
+        if (!out) {
+            perror("Failed to open output file");
+            free(index);
+            free(src.buffer);
+            releaseInput(&src.map);
+            return -1;
+        }
+    }
+
+    // 3. Decode the blocks
+    int ok = 1;
+    unsigned char* dest = mappedOut ? outMap.data : NULL;
+    unsigned long long written = index
+        ? decodeIndexedBlocks(&src.map, index, blocks, dest, out, &ok)
+        : decodeSequentialBlocks(&src, originalCharCount, dest, out, &ok);
+    if (known && written != originalCharCount) ok = 0;
+
+    // 4. Clean up (a failed write stops the decoder too, but is reported
+    //    as what it is)
+    int writeFailed = mappedOut ? unmapOutputFile(&outMap, (size_t)written) != 0 : closeOutput(out) != 0;
+    free(index);
+    free(src.buffer);
+    releaseInput(&src.map);
+
+    if (!ok || writeFailed) {
+        if (!writeFailed) fprintf(stderr, "Error: Compressed data is truncated or corrupted.\n");
+        discardOutput(outputPath);
+        return -1;
+    }
+    return 0;
+}
+
+// --- Encoder Core ---
+
+// Writes a block container holding data[0..size) as one stored or RLE
+// block (at most HUFF_MAX_BLOCK_SIZE bytes), with its index
+static void compressRawContainer(const unsigned char* data, size_t size, int type, BitWriter* bw) {
+    unsigned long long total = size;
+    unsigned nominal = (unsigned)size;
+    putBytes(bw, &MAGIC_NUMBER_BLOCKS, sizeof(unsigned int));
+    putBytes(bw, &total, sizeof(unsigned long long));
+    putBytes(bw, &nominal, sizeof(unsigned));
+    appendRawBlock(bw, type, data, size);
+
+    unsigned blockBytes = BLOCK_HEADER_SIZE + ((type == BLOCK_TYPE_RLE) ? 1 : (unsigned)size);
+    unsigned char end[BLOCK_HEADER_SIZE];
+    writeBlockHeader(end, BLOCK_TYPE_END, 0, 0);
+    putBytes(bw, end, BLOCK_HEADER_SIZE);
+
+    unsigned char index[INDEX_ENTRY_SIZE];
+    unsigned long long indexOffset = BLOCKS_START + blockBytes + BLOCK_HEADER_SIZE, blocks = 1;
+    writeIndexEntry(index, BLOCKS_START, blockBytes, nominal);
+    putBytes(bw, index, INDEX_ENTRY_SIZE);
+    putBytes(bw, &indexOffset, sizeof(unsigned long long));
+    putBytes(bw, &blocks, sizeof(unsigned long long));
+    putBytes(bw, &MAGIC_NUMBER_INDEX, sizeof(unsigned int));
+}
+
+// Writes data[0..size) as a static-table stream coded with dictionary 'id'.
+// Returns 0, or -1 (having written nothing) if the dictionary is not
+// registered or codes the data to more than its raw size.
+static int compressWithDictionary(const unsigned char* data, size_t size, unsigned id, BitWriter* bw) {
+    unsigned char lengths[NUM_CHARS];
+    HuffCode codes[NUM_CHARS];
+    if (findDictionary(id, lengths, codes) != 0) return -1;
+
+    StageClock clock;
+    startClock(&clock, statsTarget);
+
+    // 1. Size of the coded data (every byte has a code in a trained
+    //    dictionary, but one registered by hand may leave some out)
+    unsigned long long freqTable[NUM_CHARS] = {0};
+    countFrequencies(data, size, freqTable);
+    lapClock(&clock, HUFF_STAGE_HISTOGRAM);
+    unsigned long long bits = 0;
+    for (int i = 0; i < NUM_CHARS; ++i) {
+        if (freqTable[i] == 0) continue;
+        if (lengths[i] == 0) return -1;
+        bits += freqTable[i] * lengths[i];
+    }
+    if (bits > size * 8ull) return -1;
+
+    // 2. The header: magic number, char count and dictionary ID, no table
+    unsigned long long originalCharCount = size;
+    putBytes(bw, &MAGIC_NUMBER_STATIC, sizeof(unsigned int));
+    putBytes(bw, &originalCharCount, sizeof(unsigned long long));
+    putBytes(bw, &id, sizeof(unsigned));
+    lapClock(&clock, HUFF_STAGE_HEADER);
+
+    // 3. The bit stream
+    encodeSymbols(bw, data, size, codes);
+    recordBlockStats(statsTarget, freqTable, lengths, size, bits);
+    finishBits(bw);
+    lapClock(&clock, HUFF_STAGE_BITS);
+    return 0;
+}
+
+// Writes the compressed form of data[0..size) to 'bw': the block container
+// in block mode, a static-table stream with a dictionary set (unless the
+// dictionary cannot code the data), otherwise the single-stream canonical
+// format. Shared by the file and buffer APIs.
+static void compressData(const unsigned char* data, size_t size, BitWriter* bw) {
+    // Block mode: independently coded blocks on a thread pool
+    if (blockSize > 0) {
+        compressBlocks(data, size, blockSize, bw);
+        finishBits(bw);
+        return;
+    }
+    if (dictionaryId != 0 && compressWithDictionary(data, size, dictionaryId, bw) == 0) return;
+
+    StageClock clock;
+    startClock(&clock, statsTarget);
+
+    // 1. Count frequencies
+    unsigned long long freqTable[NUM_CHARS] = {0};
+    countFrequencies(data, size, freqTable);
+    lapClock(&clock, HUFF_STAGE_HISTOGRAM);
+
+    //    One repeated byte or near-random data is written as a container
+    //    of one stored or RLE block instead (below a few KB its index
+    //    costs more than it saves)
+    int type = chooseBlockType(freqTable, size);
+    if (type != BLOCK_TYPE_HUFFMAN && size >= RAW_CONTAINER_MIN_SIZE && size <= HUFF_MAX_BLOCK_SIZE) {
+        compressRawContainer(data, size, type, bw);
+        finishBits(bw);
+        lapClock(&clock, HUFF_STAGE_BITS);
+        recordBlockStats(statsTarget, freqTable, NULL, size, (type == BLOCK_TYPE_RLE) ? 8 : size * 8ull);
+        return;
+    }
+
+    // 2. Compute code lengths (limited so they fit the header nibbles)
+    //    and generate canonical codes
+    unsigned char lengths[NUM_CHARS];
+    HuffCode codes[NUM_CHARS];
+    unsigned long long bits = buildEncoderCodes(freqTable, lengths, codes, &clock);
+
+    // 3. Write the "header"
+    //    a. Magic number
+    putBytes(bw, &MAGIC_NUMBER_CANONICAL, sizeof(unsigned int));
+    //    b. Original character count (for decompression)
+    unsigned long long originalCharCount = size;
+    putBytes(bw, &originalCharCount, sizeof(unsigned long long));
+
+    // Empty input: the header alone describes it
+    if (size > 0) {
+        //    c. The code lengths (this is how we rebuild the codes)
+        unsigned char packed[CODE_LENGTHS_MAX_SIZE];
+        putBytes(bw, packed, packCodeLengths(lengths, packed));
+        lapClock(&clock, HUFF_STAGE_HEADER);
+
+        // 4. Encode the data
+        encodeSymbols(bw, data, size, codes);
+        recordBlockStats(statsTarget, freqTable, lengths, size, bits);
+    }
+
+    // Write any remaining bits (padding)
+    finishBits(bw);
+    lapClock(&clock, HUFF_STAGE_BITS);
+}
+
+// --- Streaming API ---
+
+// Compression context: input is collected into blocks of 'blockSize'
+// bytes and every full block is coded with its own table, so memory stays
+// bounded however long the input is.
+struct CompressStream {
+    size_t blockSize;
+    unsigned char* pending; // Input of the block being collected
+    size_t pendingSize;
+    BitWriter out;          // Output of the current call
+    int started;            // Container header written
+    int ended;
+};
+
+CompressStream* createCompressStream(size_t size) {
+    if (size == 0) size = HUFF_DEFAULT_BLOCK_SIZE;
+    if (size > HUFF_MAX_BLOCK_SIZE) size = HUFF_MAX_BLOCK_SIZE;
+    CompressStream* stream = (CompressStream*)calloc(1, sizeof(CompressStream));
+    if (!stream) {
+        perror("malloc error (createCompressStream)");
+        return NULL;
+    }
+    stream->blockSize = size;
+    stream->pending = (unsigned char*)malloc(size);
+    if (!stream->pending) {
+        perror("malloc error (createCompressStream)");
+        free(stream);
+        return NULL;
+    }
+    initBitWriterMemory(&stream->out, IO_BUFFER_SIZE);
+    return stream;
+}
+
+// Starts the output of a call; the first one begins with the container
+// header (the char count is not known yet)
+static int beginStreamOutput(CompressStream* stream) {
+    if (stream->ended) {
+        fprintf(stderr, "Error: Stream already ended.\n");
+        return -1;
+    }
+    if (stream->out.failed) {
+        fprintf(stderr, "Error: Stream failed (out of memory).\n");
+        return -1;
+    }
+    stream->out.pos = 0;
+    if (!stream->started) {
+        unsigned long long size = SIZE_UNKNOWN;
+        unsigned nominal = (unsigned)stream->blockSize;
+        putBytes(&stream->out, &MAGIC_NUMBER_BLOCKS, sizeof(unsigned int));
+        putBytes(&stream->out, &size, sizeof(unsigned long long));
+        putBytes(&stream->out, &nominal, sizeof(unsigned));
+        stream->started = 1;
+    }
+    return 0;
+}
+
+// Hands the output of a call to the caller. Returns its size, or -1 if
+// memory ran out (the stream cannot go on: blocks were lost).
+static long long endStreamOutput(CompressStream* stream, const unsigned char** out) {
+    if (stream->out.failed) return -1;
+    *out = stream->out.buffer;
+    return (long long)stream->out.pos;
+}
+
+static void flushPendingBlock(CompressStream* stream) {
+    if (stream->pendingSize == 0) return;
+    appendBlock(&stream->out, stream->pending, stream->pendingSize, statsTarget);
+    stream->pendingSize = 0;
+}
+
+long long compressStreamFeed(CompressStream* stream, const unsigned char* data, size_t size,
+                             const unsigned char** out) {
+    if (beginStreamOutput(stream) != 0) return -1;
+    while (size > 0) {
+        // Whole blocks are coded straight out of the caller's data
+        if (stream->pendingSize == 0 && size >= stream->blockSize) {
+            appendBlock(&stream->out, data, stream->blockSize, statsTarget);
+            data += stream->blockSize;
+            size -= stream->blockSize;
+            continue;
+        }
+        size_t n = stream->blockSize - stream->pendingSize;
+        if (n > size) n = size;
+        memcpy(stream->pending + stream->pendingSize, data, n);
+        stream->pendingSize += n;
+        data += n;
+        size -= n;
+        if (stream->pendingSize == stream->blockSize) flushPendingBlock(stream);
+    }
+    return endStreamOutput(stream, out);
+}
+
+long long compressStreamFlush(CompressStream* stream, const unsigned char** out) {
+    if (beginStreamOutput(stream) != 0) return -1;
+    flushPendingBlock(stream);
+    return endStreamOutput(stream, out);
+}
+
+long long compressStreamEnd(CompressStream* stream, const unsigned char** out) {
+    if (beginStreamOutput(stream) != 0) return -1;
+    flushPendingBlock(stream);
+    unsigned char end[BLOCK_HEADER_SIZE];
+    writeBlockHeader(end, BLOCK_TYPE_END, 0, 0);
+    putBytes(&stream->out, end, BLOCK_HEADER_SIZE);
+    stream->ended = 1;
+    return endStreamOutput(stream, out);
+}
+
+void freeCompressStream(CompressStream* stream) {
+    if (!stream) return;
+    free(stream->pending);
+    freeBitWriter(&stream->out);
+    free(stream);
+}
+
+// Compresses a stream as it is read, in bounded memory. Returns 0 on
+// success, -1 on a read or write error or if memory runs out (a failed
+// write is left on 'out' for the caller to report).
+static int compressStreamFile(FILE* in, FILE* out) {
+    unsigned char* buffer = (unsigned char*)malloc(READ_BLOCK_SIZE);
+    CompressStream* stream = createCompressStream(blockSize);
+    if (!buffer || !stream) {
+        if (!buffer) perror("malloc error (compressStreamFile)");
+        freeCompressStream(stream);
+        free(buffer);
+        return -1;
+    }
+    const unsigned char* encoded;
+    long long n = 0;
+    size_t bytesRead;
+    while (n >= 0 && (bytesRead = readBuffer(buffer, READ_BLOCK_SIZE, in)) > 0) {
+        n = compressStreamFeed(stream, buffer, bytesRead, &encoded);
+        if (n > 0 && writeBuffer(encoded, (size_t)n, out) != (size_t)n) n = -1;
+    }
+    if (n >= 0) n = compressStreamEnd(stream, &encoded);
+    if (n > 0 && writeBuffer(encoded, (size_t)n, out) != (size_t)n) n = -1;
+
+    if (ferror(in)) perror("Failed to read input file");
+    int failed = ferror(in) || n < 0;
+    freeCompressStream(stream);
+    free(buffer);
+    return failed ? -1 : 0;
+}
+
+typedef enum StreamState {
+    STREAM_HEADER,       // Waiting for the container header
+    STREAM_BLOCK_HEADER, // Waiting for a block header
+    STREAM_PAYLOAD,      // Waiting for the payload of the current block
+    STREAM_DONE,         // End marker seen; the rest (block index) is skipped
+    STREAM_FAILED
+} StreamState;
+
+// Decompression context: compressed bytes are collected until a block is
+// complete, and every block is decoded as soon as it is.
+struct DecompressStream {
+    StreamState state;
+    unsigned char* input; // Partial header or payload collected so far
+    size_t inputSize, inputCapacity;
+    int type;             // Header of the block being collected
+    unsigned rawSize, payloadSize;
+    unsigned long long total, written;
+    BitWriter out;        // Output of the current call
+};
+
+DecompressStream* createDecompressStream(void) {
+    DecompressStream* stream = (DecompressStream*)calloc(1, sizeof(DecompressStream));
+    if (!stream) {
+        perror("malloc error (createDecompressStream)");
+        return NULL;
+    }
+    stream->state = STREAM_HEADER;
+    initBitWriterMemory(&stream->out, IO_BUFFER_SIZE);
+    return stream;
+}
+
+// Returns the next 'n' bytes of input: straight out of the caller's chunk
+// when nothing is buffered, otherwise once collected in stream->input.
+// Returns NULL, keeping what there is, if the chunk ends first, or having
+// failed the stream if memory runs out.
+static const unsigned char* takeStreamInput(DecompressStream* stream, const unsigned char** data,
+                                            size_t* size, size_t n) {
+    if (stream->inputSize == 0 && *size >= n) {
+        const unsigned char* p = *data;
+        *data += n;
+        *size -= n;
+        return p;
+    }
+    if (n > stream->inputCapacity) {
+        unsigned char* input = (unsigned char*)realloc(stream->input, n);
+        if (!input) {
+            perror("malloc error (takeStreamInput)");
+            stream->state = STREAM_FAILED;
+            return NULL;
+        }
+        stream->input = input;
+        stream->inputCapacity = n;
+    }
+    size_t m = n - stream->inputSize;
+    if (m > *size) m = *size;
+    memcpy(stream->input + stream->inputSize, *data, m);
+    stream->inputSize += m;
+    *data += m;
+    *size -= m;
+    if (stream->inputSize < n) return NULL;
+    stream->inputSize = 0;
+    return stream->input;
+}
+
+static long long failStream(DecompressStream* stream, const char* message) {
+    fprintf(stderr, "Error: %s\n", message);
+    stream->state = STREAM_FAILED;
+    return -1;
+}
+
+long long decompressStreamFeed(DecompressStream* stream, const unsigned char* data, size_t size,
+                               const unsigned char** out) {
+    if (stream->state == STREAM_FAILED) return -1;
+    stream->out.pos = 0;
+    for (;;) {
+        const unsigned char* p;
+        if (stream->state == STREAM_HEADER) {
+            if (!(p = takeStreamInput(stream, &data, &size, BLOCKS_START))) break;
+            unsigned magic;
+            memcpy(&magic, p, sizeof(unsigned int));
+            memcpy(&stream->total, p + sizeof(unsigned int), sizeof(unsigned long long));
+            if (magic != MAGIC_NUMBER_BLOCKS) {
+                return failStream(stream, "Streaming decompression needs a block container (compress with --block-size).");
+            }
+            stream->state = STREAM_BLOCK_HEADER;
+        } else if (stream->state == STREAM_BLOCK_HEADER) {
+            if (!(p = takeStreamInput(stream, &data, &size, BLOCK_HEADER_SIZE))) break;
+            readBlockHeader(p, &stream->type, &stream->rawSize, &stream->payloadSize);
+            if (stream->type == BLOCK_TYPE_END) {
+                stream->state = STREAM_DONE;
+                continue;
+            }
+            // Codes are at most HUFF_MAX_CODE_LENGTH bits: bound the payload
+            // so a corrupt header cannot make us buffer gigabytes
+            if (stream->rawSize > HUFF_MAX_BLOCK_SIZE || stream->rawSize > stream->total - stream->written ||
+                stream->payloadSize > 2ull * stream->rawSize + CODE_LENGTHS_MAX_SIZE + 8) {
+                return failStream(stream, "Compressed data is corrupted.");
+            }
+            stream->state = STREAM_PAYLOAD;
+        } else if (stream->state == STREAM_PAYLOAD) {
+            if (!(p = takeStreamInput(stream, &data, &size, stream->payloadSize))) break;
+            reserveBytes(&stream->out, stream->rawSize);
+            if (stream->out.failed) return failStream(stream, "Out of memory.");
+            if (decodeBlock(stream->type, p, stream->payloadSize, stream->out.buffer + stream->out.pos,
+                            stream->rawSize, statsTarget) != 0) {
+                return failStream(stream, "Compressed data is corrupted.");
+            }
+            stream->out.pos += stream->rawSize;
+            stream->written += stream->rawSize;
+            stream->state = STREAM_BLOCK_HEADER;
+        } else {
+            break;
+        }
+    }
+    if (stream->state == STREAM_FAILED) return -1;
+    *out = stream->out.buffer;
+    return (long long)stream->out.pos;
+}
+
+int decompressStreamEnd(DecompressStream* stream) {
+    if (stream->state == STREAM_FAILED) return -1;
+    if (stream->state != STREAM_DONE || (stream->total != SIZE_UNKNOWN && stream->written != stream->total)) {
+        failStream(stream, "Compressed data is truncated or corrupted.");
+        return -1;
+    }
+    return 0;
+}
+
+void freeDecompressStream(DecompressStream* stream) {
+    if (!stream) return;
+    free(stream->input);
+    freeBitWriter(&stream->out);
+    free(stream);
+}
+
+// --- Main File I/O Functions ---
+
+static int runCompressFile(const char* inputPath, const char* outputPath) {
+    FILE *in = fopen(inputPath, "rb"); // Read in binary mode
+    if (!in) {
+        perror("Failed to open input file");
+        return -1;
+    }
+
+    // 1. Load the input once: mapped for regular files, read in for pipes
+    //    and other streams (the encoder needs two passes over it)
+    InputMap input;
+    if (mapFile(fileno(in), &input) != 0) {
+        // In block mode, streams are compressed as they arrive, in bounded memory
+        if (blockSize > 0) {
+            FILE *out = fopen(outputPath, "wb");
+            if (!out) {
+                perror("Failed to open output file");
+                fclose(in);
+                return -1;
+            }
+            int rc = compressStreamFile(in, out);
+            if (closeOutput(out) != 0) rc = -1;
+            fclose(in);
+            if (rc != 0) {
+                discardOutput(outputPath);
+                return -1;
+            }
+            reportStatus("Compression successful.");
+            return 0;
+        }
+        if (readStream(in, &input) != 0) {
+            perror("Failed to read input file");
+            fclose(in);
+            return -1;
+        }
+    }
+    fclose(in);
+
+    // 2. Open output file for writing (binary mode)
+    FILE *out = fopen(outputPath, "wb");
+    if (!out) {
+        perror("Failed to open output file");
+        releaseInput(&input);
+        return -1;
+    }
+
+    // 3. Encode straight out of the input
+    BitWriter bw;
+    initBitWriter(&bw, out);
+    compressData(input.data, input.size, &bw);
+
+    // 4. Clean up
+    int empty = (input.size == 0 && blockSize == 0);
+    int failed = bw.failed;
+    releaseInput(&input);
+    if (closeOutput(out) != 0) failed = 1;
+    freeBitWriter(&bw);
+
+    if (failed) {
+        discardOutput(outputPath);
+        return -1;
+    }
+    if (empty) {
+        reportStatus("Input file is empty. Wrote header only.");
+        return 0;
+    }
+    reportStatus("Compression successful.");
+    return 0;
+}
+
+static int checkShuffledBody(const unsigned char* body, size_t bodySize, unsigned long long total, unsigned* width);
+static int decodeShuffled(const unsigned char* body, size_t bodySize, unsigned long long total, unsigned char* dest);
+
+// Decodes a shuffled array (the rest of 'in' after its magic number and
+// char count) into outputPath. The planes are unshuffled in memory, so the
+// whole input is read or mapped.
+static int decompressShuffledFile(FILE* in, const char* outputPath, unsigned long long total) {
+    // 1. The body: mapped (it starts after the header), or read to the end
+    InputMap input = {NULL, 0, 0};
+    const unsigned char* body;
+    size_t bodySize;
+    if (mapFile(fileno(in), &input) == 0 && input.size >= STREAM_HEADER_SIZE) {
+        body = input.data + STREAM_HEADER_SIZE;
+        bodySize = input.size - STREAM_HEADER_SIZE;
+    } else {
+        releaseInput(&input);
+        if (readStream(in, &input) != 0) return -1;
+        body = input.data;
+        bodySize = input.size;
+    }
+    if (checkShuffledBody(body, bodySize, total, NULL) != 0) {
+        fprintf(stderr, "Error: Compressed data is truncated or corrupted.\n");
+        releaseInput(&input);
+        return -1;
+    }
+
+    // 2. Decode into the output: mapped at its final size when possible
+    OutputMap outMap;
+    int mappedOut = (mapOutputFile(outputPath, total, &outMap) == 0);
+    unsigned char* dest = mappedOut ? outMap.data : (unsigned char*)malloc((size_t)total);
+    if (!dest) {
+        perror("malloc error (decompressShuffledFile)");
+        releaseInput(&input);
+        return -1;
+    }
+    int rc = decodeShuffled(body, bodySize, total, dest);
+    releaseInput(&input);
+    if (rc != 0) fprintf(stderr, "Error: Compressed data is truncated or corrupted.\n");
+
+    // 3. Write it out
+    if (mappedOut) {
+        if (unmapOutputFile(&outMap, rc == 0 ? (size_t)total : 0) != 0) rc = -1;
+        if (rc != 0) discardOutput(outputPath);
+    } else {
+        FILE* out = fopen(outputPath, "wb");
+        if (!out) {
+            perror("Failed to open output file");
+            rc = -1;
+        } else {
+            if (rc == 0 && writeBuffer(dest, (size_t)total, out) != total) rc = -1;
+            if (closeOutput(out) != 0) rc = -1;
+            if (rc != 0) discardOutput(outputPath);
+        }
+        free(dest);
+    }
+    return rc;
+}
+
+// Creates the empty output of an empty input. Returns 0 on success, -1 on
+// error.
+static int writeEmptyOutput(const char* outputPath) {
+    FILE *out = fopen(outputPath, "wb");
+    if (!out) {
+        perror("Failed to open output file");
+        return -1;
+    }
+    if (closeOutput(out) != 0) return -1;
+    reportStatus("Decompression successful (empty file).");
+    return 0;
+}
+
+static int runDecompressFile(const char* inputPath, const char* outputPath) {
+    FILE *in = fopen(inputPath, "rb");
+    if (!in) {
+        perror("Failed to open input file");
+        return -1;
+    }
+
+    // 1. Read and verify magic number
+    unsigned int magic;
+    if (fread(&magic, sizeof(unsigned int), 1, in) != 1) {
+        // Older versions wrote empty inputs as empty files
+        if (feof(in) && ftell(in) == 0) {
+            fclose(in);
+            return writeEmptyOutput(outputPath);
+        }
+        magic = 0;
+    }
+    if (magic != MAGIC_NUMBER && magic != MAGIC_NUMBER_CANONICAL && magic != MAGIC_NUMBER_STATIC &&
+        magic != MAGIC_NUMBER_BLOCKS && magic != MAGIC_NUMBER_SHUFFLED) {
+        fprintf(stderr, "Error: Not a valid .huff file or file is corrupted.\n");
+        fclose(in);
+        return -1;
+    }
+
+    // 2. Read original char count
+    unsigned long long originalCharCount;
+    
+    if (fread(&originalCharCount, sizeof(unsigned long long), 1, in) != 1) {
+         fprintf(stderr, "Error: Failed to read header.\n");
+         fclose(in);
+         return -1;
+    }
+    
+    // Handle empty file
+    if (originalCharCount == 0) {
+        fclose(in);
+        return writeEmptyOutput(outputPath);
+    }
+
+    // Block container: every block carries its own code lengths
+    if (magic == MAGIC_NUMBER_BLOCKS) {
+        resolveStreamSize(in, &originalCharCount);
+        int rc = decompressBlocks(in, outputPath, originalCharCount);
+        fclose(in);
+        if (rc == 0) reportStatus("Decompression successful.");
+        return rc;
+    }
+
+    // Shuffled array: a block container of byte planes
+    if (magic == MAGIC_NUMBER_SHUFFLED) {
+        int rc = decompressShuffledFile(in, outputPath, originalCharCount);
+        fclose(in);
+        if (rc == 0) reportStatus("Decompression successful.");
+        return rc;
+    }
+
+    // 3. Rebuild the codes: the tree from the frequency table (legacy
+    //    format), or the tables straight from the code lengths (canonical,
+    //    or those of the dictionary a static-table stream names)
+    StageClock clock;
+    startClock(&clock, statsTarget);
+    HuffTree* tree = NULL;
+    DecodeTable* table = NULL;
+    if (readStreamCodes(in, magic, &tree, &table, statsTarget) != 0) {
+        fclose(in);
+        return -1;
+    }
+    lapClock(&clock, HUFF_STAGE_CODES);
+
+    // 4. Read the bit stream straight out of a mapping of the input if it
+    //    is a regular file, otherwise through buffered reads
+    BitReader br;
+    InputMap input = {NULL, 0, 0};
+    long dataStart = ftell(in);
+    if (dataStart >= 0 && mapFile(fileno(in), &input) == 0 && (size_t)dataStart <= input.size) {
+        // Every symbol takes at least one bit: bound the count before the
+        // output is sized from it
+        if (originalCharCount > (input.size - (size_t)dataStart) * 8ull) {
+            fprintf(stderr, "Error: Compressed data is truncated or corrupted.\n");
+            releaseInput(&input);
+            fclose(in);
+            free(tree);
+            releaseDecodeTable(table);
+            return -1;
+        }
+        initBitReaderMemory(&br, input.data + dataStart, input.size - (size_t)dataStart);
+    } else if (initBitReaderStream(&br, in) != 0) {
+        releaseInput(&input);
+        fclose(in);
+        free(tree);
+        releaseDecodeTable(table);
+        return -1;
+    }
+
+    // 5. Open output file: mapped at its final size when possible
+    OutputMap outMap;
+    FILE *out = NULL;
+    int mappedOut = (mapOutputFile(outputPath, originalCharCount, &outMap) == 0);
+    if (!mappedOut) {
+        out = fopen(outputPath, "wb");
+        if (!out) {
+            perror("Failed to open output file");
+            freeBitReader(&br);
+            releaseInput(&input);
+            fclose(in);
+            free(tree);
+            releaseDecodeTable(table);
+            return -1;
+        }
+    }
+
+    // 6. Decode the bit stream
+    int ok = 1;
+    unsigned long long written = decodeToOutput(&br, table, tree, mappedOut ? outMap.data : NULL, out,
+                                                originalCharCount, &ok);
+    lapClock(&clock, HUFF_STAGE_BITS);
+    if (statsTarget) {
+        statsTarget->symbols += written;
+        if (input.data) statsTarget->codedBits += (input.size - (size_t)dataStart) * 8ull;
+    }
+
+    // 7. Clean up
+    int writeFailed = mappedOut ? unmapOutputFile(&outMap, (size_t)written) != 0 : closeOutput(out) != 0;
+    freeBitReader(&br);
+    releaseInput(&input);
+    fclose(in);
+    free(tree);
+    releaseDecodeTable(table);
+
+    if (!ok || writeFailed) {
+        if (!writeFailed) fprintf(stderr, "Error: Compressed data is truncated or corrupted.\n");
+        discardOutput(outputPath);
+        return -1;
+    }
+    reportStatus("Decompression successful.");
+    return 0;
+}
+
+// Size of a regular file, or 'fallback' for pipes and devices
+static unsigned long long regularFileSize(const char* path, unsigned long long fallback) {
+#ifdef HUFF_HAVE_MMAP
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) return (unsigned long long)st.st_size;
+#else
+    (void)path;
+#endif
+    return fallback;
+}
+
+int compressFile(const char* inputPath, const char* outputPath) {
+    beginStats(1);
+    int rc = runCompressFile(inputPath, outputPath);
+    if (statsTarget) {
+        endStats(regularFileSize(inputPath, statsTarget->bytesIn), regularFileSize(outputPath, statsTarget->bytesOut));
+    }
+    return rc;
+}
+
+int decompressFile(const char* inputPath, const char* outputPath) {
+    beginStats(0);
+    int rc = runDecompressFile(inputPath, outputPath);
+    if (statsTarget) {
+        endStats(regularFileSize(inputPath, statsTarget->bytesIn), regularFileSize(outputPath, statsTarget->bytesOut));
+    }
+    return rc;
+}
+
+
+// --- Random Access ---
+
+// Copies the part of src (original bytes [srcStart, srcStart + n)) that
+// falls inside [offset, offset + length) to dest.
+static void copyOverlap(const unsigned char* src, unsigned long long srcStart, size_t n,
+                        unsigned char* dest, unsigned long long offset, unsigned long long length) {
+    unsigned long long from = srcStart > offset ? srcStart : offset;
+    unsigned long long to = (srcStart + n < offset + length) ? srcStart + n : offset + length;
+    if (from < to) memcpy(dest + (from - offset), src + (from - srcStart), (size_t)(to - from));
+}
+
+// Single-stream files have no sync points: decode from the start and keep
+// only the range. Returns 0 on success, -1 on error.
+static int decodeStreamRange(FILE* in, unsigned int magic, unsigned long long offset,
+                             unsigned long long length, unsigned char* dest) {
+    HuffTree* tree;
+    DecodeTable* table;
+    if (readStreamCodes(in, magic, &tree, &table, NULL) != 0) return -1;
+
+    BitReader br;
+    InputMap input = {NULL, 0, 0};
+    long dataStart = ftell(in);
+    if (dataStart >= 0 && mapFile(fileno(in), &input) == 0 && (size_t)dataStart <= input.size) {
+        initBitReaderMemory(&br, input.data + dataStart, input.size - (size_t)dataStart);
+    } else if (initBitReaderStream(&br, in) != 0) {
+        releaseInput(&input);
+        free(tree);
+        releaseDecodeTable(table);
+        return -1;
+    }
+    unsigned char* buffer = (unsigned char*)malloc(IO_BUFFER_SIZE);
+    int ok = (buffer != NULL);
+    if (!buffer) perror("malloc error (decodeStreamRange)");
+
+    unsigned long long end = offset + length, done = 0;
+    while (ok && done < end) {
+        size_t want = (end - done < IO_BUFFER_SIZE) ? (size_t)(end - done) : IO_BUFFER_SIZE;
+        int last = (done + want == end); // Nothing after the range is needed
+        size_t n = table ? decodeTableSymbols(&br, table, buffer, want, last, &ok)
+                         : decodeTreeSymbols(&br, tree, buffer, want, &ok);
+        copyOverlap(buffer, done, n, dest, offset, length);
+        done += n;
+    }
+
+    free(buffer);
+    freeBitReader(&br);
+    releaseInput(&input);
+    free(tree);
+    releaseDecodeTable(table);
+    return ok ? 0 : -1;
+}
+
+// Block containers: find the covering blocks through the block index
+// (or, without one, by following the block headers) and decode only those.
+// Returns 0 on success, -1 on error.
+static int decodeBlockRange(FILE* in, unsigned long long total, unsigned long long offset,
+                            unsigned long long length, unsigned char* dest) {
+    unsigned nominal;
+    if (fread(&nominal, sizeof(unsigned), 1, in) != 1) return -1;
+
+    BlockInput src = {in, {NULL, 0, 0}, 0, NULL, 0};
+    BlockIndexEntry* index = NULL;
+    unsigned long long blocks = 0;
+    long dataStart = ftell(in);
+    if (dataStart >= 0 && mapFile(fileno(in), &src.map) == 0 && (size_t)dataStart <= src.map.size) {
+        src.in = NULL;
+        src.pos = (size_t)dataStart;
+        index = readBlockIndex(&src.map, total, &blocks);
+    }
+
+    unsigned long long end = offset + length;
+    int ok = 1;
+    if (index) {
+        // 1. Binary search for the first block that ends after 'offset'
+        unsigned long long lo = 0, hi = blocks;
+        while (lo < hi) {
+            unsigned long long mid = lo + (hi - lo) / 2;
+            if (index[mid].rawOffset + index[mid].rawSize <= offset) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        unsigned long long first = lo, last = lo;
+        while (last < blocks && index[last].rawOffset < end) last++;
+        size_t n = (size_t)(last - first);
+
+        // 2. Decode the covering blocks: whole blocks straight into dest,
+        //    partly covered ones (at most the first and last) into scratch
+        DecodeJob* jobs = (DecodeJob*)malloc(n * sizeof(DecodeJob) + 1);
+        if (!jobs) {
+            perror("malloc error (decodeBlockRange)");
+            n = 0;
+            ok = 0;
+        }
+        for (size_t k = 0; k < n; ++k) {
+            const BlockIndexEntry* e = &index[first + k];
+            jobs[k].block = src.map.data + e->offset;
+            jobs[k].blockSize = e->compressedSize;
+            jobs[k].rawSize = e->rawSize;
+            jobs[k].failed = 0;
+            jobs[k].stats = NULL;
+            if (e->rawOffset >= offset && e->rawOffset + e->rawSize <= end) {
+                jobs[k].dest = dest + (e->rawOffset - offset);
+            } else {
+                jobs[k].dest = (unsigned char*)malloc(e->rawSize + 1);
+                if (!jobs[k].dest) {
+                    perror("malloc error (decodeBlockRange)");
+                    n = k; // Only the jobs before this one need freeing
+                    ok = 0;
+                }
+            }
+        }
+        if (ok) {
+            ThreadPool* pool = acquirePool(n);
+            for (size_t k = 0; k < n; ++k) submitPoolJob(pool, runDecodeJob, &jobs[k]);
+            waitForPoolJobs(pool);
+            releasePool(pool);
+        }
+
+        // 3. Copy the covered parts of the partial blocks
+        for (size_t k = 0; k < n; ++k) {
+            const BlockIndexEntry* e = &index[first + k];
+            if (jobs[k].failed) ok = 0;
+            if (!(e->rawOffset >= offset && e->rawOffset + e->rawSize <= end)) {
+                if (!jobs[k].failed) copyOverlap(jobs[k].dest, e->rawOffset, e->rawSize, dest, offset, length);
+                free(jobs[k].dest);
+            }
+        }
+        free(jobs);
+    } else {
+        // No index: walk the block headers, skipping payloads before the range
+        unsigned long long rawStart = 0;
+        unsigned char* scratch = NULL;
+        size_t scratchSize = 0;
+        while (ok && rawStart < end) {
+            const unsigned char* header = readBlockInput(&src, BLOCK_HEADER_SIZE);
+            int type;
+            unsigned rawSize, payloadSize;
+            if (!header) { ok = 0; break; }
+            readBlockHeader(header, &type, &rawSize, &payloadSize);
+            const unsigned char* payload = readBlockInput(&src, payloadSize);
+            if (type == BLOCK_TYPE_END || !payload) { ok = 0; break; }
+
+            if (rawStart + rawSize > offset) {
+                if (rawSize > scratchSize) {
+                    unsigned char* grown = (unsigned char*)realloc(scratch, rawSize);
+                    if (!grown) {
+                        perror("malloc error (decodeBlockRange)");
+                        ok = 0;
+                        break;
+                    }
+                    scratch = grown;
+                    scratchSize = rawSize;
+                }
+                if (decodeBlock(type, payload, payloadSize, scratch, rawSize, NULL) != 0) { ok = 0; break; }
+                copyOverlap(scratch, rawStart, rawSize, dest, offset, length);
+            }
+            rawStart += rawSize;
+        }
+        free(scratch);
+    }
+
+    free(index);
+    free(src.buffer);
+    releaseInput(&src.map);
+    return ok ? 0 : -1;
+}
+
+// Opens a compressed file and reads its magic number and char count.
+// Returns the open file, or NULL on error.
+static FILE* openCompressedFile(const char* inputPath, unsigned int* magic, unsigned long long* total) {
+    FILE* in = fopen(inputPath, "rb");
+    if (!in) {
+        perror("Failed to open input file");
+        return NULL;
+    }
+    if (fread(magic, sizeof(unsigned int), 1, in) != 1) {
+        // Older versions wrote empty inputs as empty files
+        if (feof(in) && ftell(in) == 0) {
+            *magic = MAGIC_NUMBER_CANONICAL;
+            *total = 0;
+            return in;
+        }
+        *magic = 0;
+    }
+    // The planes of a shuffled array hold every element's bytes far apart
+    if (*magic == MAGIC_NUMBER_SHUFFLED) {
+        fprintf(stderr, "Error: Range extraction not supported for shuffled files (decompress them whole).\n");
+        fclose(in);
+        return NULL;
+    }
+    if ((*magic != MAGIC_NUMBER && *magic != MAGIC_NUMBER_CANONICAL && *magic != MAGIC_NUMBER_STATIC &&
+         *magic != MAGIC_NUMBER_BLOCKS) ||
+        fread(total, sizeof(unsigned long long), 1, in) != 1) {
+        fprintf(stderr, "Error: Not a valid .huff file or file is corrupted.\n");
+        fclose(in);
+        return NULL;
+    }
+    resolveStreamSize(in, total);
+    if (*total == SIZE_UNKNOWN) {
+        fprintf(stderr, "Error: Size of streamed data unknown (truncated, or not a regular file).\n");
+        fclose(in);
+        return NULL;
+    }
+    return in;
+}
+
+// Clamps [offset, offset + *length) to the original data
+static void clampRange(unsigned long long total, unsigned long long offset, unsigned long long* length) {
+    if (offset >= total) {
+        *length = 0;
+    } else if (*length > total - offset) {
+        *length = total - offset;
+    }
+}
+
+static int decodeRange(FILE* in, unsigned int magic, unsigned long long total,
+                       unsigned long long offset, unsigned long long length, unsigned char* dest) {
+    if (length == 0) return 0;
+    return (magic == MAGIC_NUMBER_BLOCKS) ? decodeBlockRange(in, total, offset, length, dest)
+                                          : decodeStreamRange(in, magic, offset, length, dest);
+}
+
+long long readRange(const char* inputPath, unsigned long long offset, unsigned long long length,
+                    unsigned char* dest) {
+    unsigned int magic;
+    unsigned long long total;
+    FILE* in = openCompressedFile(inputPath, &magic, &total);
+    if (!in) return -1;
+
+    clampRange(total, offset, &length);
+    int rc = decodeRange(in, magic, total, offset, length, dest);
+    fclose(in);
+    if (rc != 0) {
+        fprintf(stderr, "Error: Compressed data is truncated or corrupted.\n");
+        return -1;
+    }
+    return (long long)length;
+}
+
+int extractRange(const char* inputPath, const char* outputPath, unsigned long long offset,
+                 unsigned long long length) {
+    unsigned int magic;
+    unsigned long long total;
+    FILE* in = openCompressedFile(inputPath, &magic, &total);
+    if (!in) return -1;
+    clampRange(total, offset, &length);
+
+    // Decode into a mapping of the output when possible
+    OutputMap outMap;
+    unsigned char* dest;
+    int mappedOut = (mapOutputFile(outputPath, length, &outMap) == 0);
+    if (mappedOut) {
+        dest = outMap.data;
+    } else {
+        dest = (unsigned char*)malloc((size_t)length + 1);
+        if (!dest) {
+            perror("malloc error (extractRange)");
+            fclose(in);
+            return -1;
+        }
+    }
+
+    int rc = decodeRange(in, magic, total, offset, length, dest);
+    fclose(in);
+    if (rc != 0) fprintf(stderr, "Error: Compressed data is truncated or corrupted.\n");
+
+    if (mappedOut) {
+        if (unmapOutputFile(&outMap, rc == 0 ? (size_t)length : 0) != 0) rc = -1;
+    } else {
+        FILE* out = fopen(outputPath, "wb");
+        if (!out) {
+            perror("Failed to open output file");
+            rc = -1;
+        } else {
+            if (rc == 0 && writeBuffer(dest, (size_t)length, out) != length) rc = -1;
+            if (closeOutput(out) != 0) rc = -1;
+        }
+        free(dest);
+    }
+
+    if (rc != 0) {
+        discardOutput(outputPath);
+        return -1;
+    }
+    printf("Extracted %llu bytes at offset %llu.\n", length, offset);
+    return 0;
+}
+
+// --- Byte Shuffling ---
+
+// Splits 'count' elements of 'width' bytes into byte planes: plane k holds
+// byte k of every element. The common widths get a constant width, so the
+// inner loop unrolls.
+static inline void shufflePlanes(const unsigned char* src, size_t count, size_t width, unsigned char* dest) {
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t k = 0; k < width; ++k) dest[k * count + i] = src[i * width + k];
+    }
+}
+
+static inline void unshufflePlanes(const unsigned char* src, size_t count, size_t width, unsigned char* dest) {
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t k = 0; k < width; ++k) dest[i * width + k] = src[k * count + i];
+    }
+}
+
+// Shuffles data[0..size) of 'width'-byte elements into 'dest'. Bytes past
+// the last whole element are copied as they are.
+static void shuffleBytes(const unsigned char* src, size_t size, size_t width, unsigned char* dest) {
+    size_t count = size / width;
+    switch (width) {
+        case 2: shufflePlanes(src, count, 2, dest); break;
+        case 4: shufflePlanes(src, count, 4, dest); break;
+        case 8: shufflePlanes(src, count, 8, dest); break;
+        default: shufflePlanes(src, count, width, dest); break;
+    }
+    memcpy(dest + count * width, src + count * width, size - count * width);
+}
+
+static void unshuffleBytes(const unsigned char* src, size_t size, size_t width, unsigned char* dest) {
+    size_t count = size / width;
+    switch (width) {
+        case 2: unshufflePlanes(src, count, 2, dest); break;
+        case 4: unshufflePlanes(src, count, 4, dest); break;
+        case 8: unshufflePlanes(src, count, 8, dest); break;
+        default: unshufflePlanes(src, count, width, dest); break;
+    }
+    memcpy(dest + count * width, src + count * width, size - count * width);
+}
+
+// Block size of a shuffled container: one block per plane (planes over
+// HUFF_MAX_BLOCK_SIZE are split)
+static size_t planeBlockSize(size_t size, size_t width) {
+    size_t count = size / width;
+    if (count == 0) count = size > 0 ? size : 1;
+    return count < HUFF_MAX_BLOCK_SIZE ? count : HUFF_MAX_BLOCK_SIZE;
+}
+
+// --- Buffer API ---
+
+// Largest block container for 'size' bytes in blocks of 'blockBytes'
+static size_t containerBound(size_t size, size_t blockBytes) {
+    // Interleaved blocks add a jump table, and each stream may pad a byte
+    size_t blocks = (size + blockBytes - 1) / blockBytes;
+    size_t streams = streamCount > 1 ? JUMP_TABLE_SIZE + HUFF_INTERLEAVED_STREAMS : 0;
+    return STREAM_HEADER_SIZE + sizeof(unsigned) + size +
+           blocks * (BLOCK_HEADER_SIZE + CODE_LENGTHS_MAX_SIZE + INDEX_ENTRY_SIZE + streams) +
+           BLOCK_HEADER_SIZE + INDEX_FOOTER_SIZE + 8;
+}
+
+size_t compressBufferBound(size_t size) {
+    // The encoder never spends more than 8 bits a byte (the lengths are
+    // optimal under a limit of at least 8 bits, so they never cost more than
+    // a flat 8-bit code); the last 8 bytes are slack
+    if (blockSize == 0) {
+        return STREAM_HEADER_SIZE + CODE_LENGTHS_MAX_SIZE + size + 8;
+    }
+    return containerBound(size, blockSize);
+}
+
+long long compressBuffer(const unsigned char* src, size_t srcSize, unsigned char* dest, size_t destCapacity) {
+    beginStats(1);
+    BitWriter bw;
+    initBitWriterBuffer(&bw, dest, destCapacity);
+    compressData(src, srcSize, &bw);
+    int overflow = bw.overflow, failed = bw.failed;
+    size_t written = bw.pos;
+    freeBitWriter(&bw);
+    endStats(srcSize, (overflow || failed) ? 0 : written);
+    if (overflow) {
+        fprintf(stderr, "Error: Output buffer too small (use compressBufferBound).\n");
+        return -1;
+    }
+    return failed ? -1 : (long long)written;
+}
+
+unsigned char* compressBufferAlloc(const unsigned char* src, size_t srcSize, size_t* destSize) {
+    beginStats(1);
+    BitWriter bw;
+    initBitWriterMemory(&bw, compressBufferBound(srcSize));
+    compressData(src, srcSize, &bw);
+    if (bw.failed) {
+        freeBitWriter(&bw);
+        endStats(srcSize, 0);
+        return NULL;
+    }
+    *destSize = bw.pos;
+    endStats(srcSize, bw.pos);
+    return bw.buffer;
+}
+
+size_t compressShuffledBound(size_t size, size_t elementSize) {
+    if (elementSize == 0) elementSize = 1;
+    return SHUFFLED_HEADER_SIZE + containerBound(size, planeBlockSize(size, elementSize));
+}
+
+long long compressShuffled(const unsigned char* src, size_t srcSize, size_t elementSize, unsigned char* dest,
+                           size_t destCapacity) {
+    if (elementSize == 0 || elementSize > HUFF_MAX_ELEMENT_SIZE) {
+        fprintf(stderr, "Error: Invalid element size %zu.\n", elementSize);
+        return -1;
+    }
+    beginStats(1);
+
+    // 1. Byte planes
+    StageClock clock;
+    startClock(&clock, statsTarget);
+    unsigned char* planes = (unsigned char*)malloc(srcSize + 1);
+    if (!planes) {
+        perror("malloc error (compressShuffled)");
+        endStats(srcSize, 0);
+        return -1;
+    }
+    shuffleBytes(src, srcSize, elementSize, planes);
+    lapClock(&clock, HUFF_STAGE_READ);
+
+    // 2. Header, then the planes as a block container: each plane is a
+    //    block, with its own table (or stored, or run-length coded)
+    BitWriter bw;
+    initBitWriterBuffer(&bw, dest, destCapacity);
+    unsigned long long total = srcSize;
+    unsigned width = (unsigned)elementSize;
+    putBytes(&bw, &MAGIC_NUMBER_SHUFFLED, sizeof(unsigned int));
+    putBytes(&bw, &total, sizeof(unsigned long long));
+    putBytes(&bw, &width, sizeof(unsigned));
+    compressBlocks(planes, srcSize, planeBlockSize(srcSize, elementSize), &bw);
+    finishBits(&bw);
+    free(planes);
+
+    int overflow = bw.overflow, failed = bw.failed;
+    size_t written = bw.pos;
+    freeBitWriter(&bw);
+    endStats(srcSize, (overflow || failed) ? 0 : written);
+    if (overflow) {
+        fprintf(stderr, "Error: Output buffer too small (use compressShuffledBound).\n");
+        return -1;
+    }
+    return failed ? -1 : (long long)written;
+}
+
+// Reads the magic number and char count at the start of a compressed
+// buffer. Returns 0 on success, -1 if it is not a compressed buffer or the
+// char count is more than its blocks or bits can hold (so a forged count
+// never gets allocated).
+static int readBufferHeader(const unsigned char* src, size_t srcSize, unsigned int* magic,
+                            unsigned long long* total) {
+    if (srcSize == 0) {
+        // Older versions wrote empty inputs as empty files
+        *magic = MAGIC_NUMBER_CANONICAL;
+        *total = 0;
+        return 0;
+    }
+    if (srcSize < STREAM_HEADER_SIZE) return -1;
+    memcpy(magic, src, sizeof(unsigned int));
+    memcpy(total, src + sizeof(unsigned int), sizeof(unsigned long long));
+    if (*magic == MAGIC_NUMBER_BLOCKS) {
+        // The blocks add up to the char count (a streamed container only
+        // has theirs)
+        if (srcSize < BLOCKS_START) return -1;
+        unsigned long long sum = sumBlockSizes(src + BLOCKS_START, srcSize - BLOCKS_START);
+        if (sum == SIZE_UNKNOWN || (*total != SIZE_UNKNOWN && sum != *total)) return -1;
+        *total = sum;
+        return 0;
+    }
+    if (*magic == MAGIC_NUMBER_SHUFFLED) {
+        return checkShuffledBody(src + STREAM_HEADER_SIZE, srcSize - STREAM_HEADER_SIZE, *total, NULL);
+    }
+    size_t headerSize = (*magic == MAGIC_NUMBER_STATIC) ? STATIC_HEADER_SIZE : STREAM_HEADER_SIZE;
+    if (srcSize < headerSize) return -1;
+    // Every symbol of a single stream takes at least one bit
+    if (*total > (srcSize - headerSize) * 8ull) return -1;
+    return (*magic == MAGIC_NUMBER || *magic == MAGIC_NUMBER_CANONICAL || *magic == MAGIC_NUMBER_STATIC) ? 0 : -1;
+}
+
+// Checks the body of a shuffled array (the element size, then the block
+// container of the planes) and sets *width if it is not NULL. Returns 0 if
+// the planes hold 'total' bytes, -1 if not.
+static int checkShuffledBody(const unsigned char* body, size_t bodySize, unsigned long long total, unsigned* width) {
+    unsigned elementSize;
+    unsigned int magic;
+    unsigned long long planesSize;
+    if (bodySize < sizeof(unsigned)) return -1;
+    memcpy(&elementSize, body, sizeof(unsigned));
+    if (elementSize == 0 || elementSize > HUFF_MAX_ELEMENT_SIZE ||
+        readBufferHeader(body + sizeof(unsigned), bodySize - sizeof(unsigned), &magic, &planesSize) != 0 ||
+        magic != MAGIC_NUMBER_BLOCKS || planesSize != total) {
+        return -1;
+    }
+    if (width) *width = elementSize;
+    return 0;
+}
+
+long long decompressedSize(const unsigned char* src, size_t srcSize) {
+    unsigned int magic;
+    unsigned long long total;
+    if (readBufferHeader(src, srcSize, &magic, &total) != 0 || total > (unsigned long long)LLONG_MAX) {
+        return -1;
+    }
+    return (long long)total;
+}
+
+// Decodes a whole compressed buffer into dest[0..total). Returns 0 on
+// success, -1 on corrupt input.
+static int decodeBuffer(const unsigned char* src, size_t srcSize, unsigned int magic,
+                        unsigned long long total, unsigned char* dest) {
+    if (total == 0) return 0;
+    int ok = 1;
+
+    // Block container: the same decoders as for a mapped file
+    if (magic == MAGIC_NUMBER_BLOCKS) {
+        if (srcSize < BLOCKS_START) return -1;
+        BlockInput bi = {NULL, {src, srcSize, 0}, BLOCKS_START, NULL, 0};
+        unsigned long long blocks = 0;
+        BlockIndexEntry* index = readBlockIndex(&bi.map, total, &blocks);
+        unsigned long long written = index ? decodeIndexedBlocks(&bi.map, index, blocks, dest, NULL, &ok)
+                                           : decodeSequentialBlocks(&bi, total, dest, NULL, &ok);
+        free(index);
+        return (ok && written == total) ? 0 : -1;
+    }
+    if (magic == MAGIC_NUMBER_SHUFFLED) {
+        return decodeShuffled(src + STREAM_HEADER_SIZE, srcSize - STREAM_HEADER_SIZE, total, dest);
+    }
+
+    // Single stream: frequency table (legacy), code lengths or a
+    // dictionary ID, then the bits
+    StageClock clock;
+    startClock(&clock, statsTarget);
+    size_t pos = STREAM_HEADER_SIZE;
+    HuffTree* tree;
+    DecodeTable* table;
+    int rc;
+    if (magic == MAGIC_NUMBER) {
+        unsigned long long freqTable[NUM_CHARS];
+        if (srcSize - pos < sizeof(freqTable)) return -1;
+        memcpy(freqTable, src + pos, sizeof(freqTable));
+        pos += sizeof(freqTable);
+        rc = buildStreamDecoder(freqTable, NULL, &tree, &table);
+    } else {
+        unsigned char lengths[NUM_CHARS];
+        if (magic == MAGIC_NUMBER_STATIC) {
+            unsigned id;
+            memcpy(&id, src + pos, sizeof(unsigned)); // readBufferHeader checked the size
+            pos += sizeof(unsigned);
+            if (findDictionary(id, lengths, NULL) != 0) {
+                fprintf(stderr, "Error: Unknown dictionary %u.\n", id);
+                return -1;
+            }
+        } else {
+            size_t n = unpackCodeLengths(src + pos, srcSize - pos, lengths);
+            if (n == 0) return -1;
+            pos += n;
+        }
+        recordBlockStats(statsTarget, NULL, lengths, 0, 0);
+        rc = buildStreamDecoder(NULL, lengths, &tree, &table);
+    }
+    if (rc != 0) return -1;
+    lapClock(&clock, HUFF_STAGE_CODES);
+
+    BitReader br;
+    initBitReaderMemory(&br, src + pos, srcSize - pos);
+    unsigned long long written = decodeToOutput(&br, table, tree, dest, NULL, total, &ok);
+    lapClock(&clock, HUFF_STAGE_BITS);
+    if (statsTarget) {
+        statsTarget->symbols += written;
+        statsTarget->codedBits += (srcSize - pos) * 8ull;
+    }
+    freeBitReader(&br);
+    free(tree);
+    releaseDecodeTable(table);
+    return (ok && written == total) ? 0 : -1;
+}
+
+// Decodes the body of a shuffled buffer (the element size, then the block
+// container of the planes) into dest[0..total). Returns 0 on success, -1
+// on corrupt input.
+static int decodeShuffled(const unsigned char* body, size_t bodySize, unsigned long long total, unsigned char* dest) {
+    unsigned width;
+    if (checkShuffledBody(body, bodySize, total, &width) != 0) return -1;
+    body += sizeof(unsigned);
+    bodySize -= sizeof(unsigned);
+
+    unsigned char* planes = (unsigned char*)malloc((size_t)total);
+    if (!planes) {
+        perror("malloc error (decodeShuffled)");
+        return -1;
+    }
+    int rc = decodeBuffer(body, bodySize, MAGIC_NUMBER_BLOCKS, total, planes);
+    if (rc == 0) {
+        StageClock clock;
+        startClock(&clock, statsTarget);
+        unshuffleBytes(planes, (size_t)total, width, dest);
+        lapClock(&clock, HUFF_STAGE_WRITE);
+    }
+    free(planes);
+    return rc;
+}
+
+long long decompressBuffer(const unsigned char* src, size_t srcSize, unsigned char* dest, size_t destCapacity) {
+    unsigned int magic;
+    unsigned long long total;
+    if (readBufferHeader(src, srcSize, &magic, &total) != 0) {
+        fprintf(stderr, "Error: Not a valid compressed buffer or buffer is corrupted.\n");
+        return -1;
+    }
+    if (total > destCapacity) {
+        fprintf(stderr, "Error: Output buffer too small (%llu bytes needed).\n", total);
+        return -1;
+    }
+    beginStats(0);
+    int rc = decodeBuffer(src, srcSize, magic, total, dest);
+    endStats(srcSize, rc == 0 ? total : 0);
+    if (rc != 0) {
+        fprintf(stderr, "Error: Compressed data is truncated or corrupted.\n");
+        return -1;
+    }
+    return (long long)total;
+}
+
+unsigned char* decompressBufferAlloc(const unsigned char* src, size_t srcSize, size_t* destSize) {
+    unsigned int magic;
+    unsigned long long total;
+    if (readBufferHeader(src, srcSize, &magic, &total) != 0 || total > (size_t)-1 - 1) {
+        fprintf(stderr, "Error: Not a valid compressed buffer or buffer is corrupted.\n");
+        return NULL;
+    }
+    unsigned char* dest = (unsigned char*)malloc((size_t)total + 1);
+    if (!dest) {
+        perror("malloc error (decompressBufferAlloc)");
+        return NULL;
+    }
+    beginStats(0);
+    int rc = decodeBuffer(src, srcSize, magic, total, dest);
+    endStats(srcSize, rc == 0 ? total : 0);
+    if (rc != 0) {
+        fprintf(stderr, "Error: Compressed data is truncated or corrupted.\n");
+        free(dest);
+        return NULL;
+    }
+    *destSize = (size_t)total;
+    return dest;
+}
+
+// --- Compression Context ---
+
+HuffContext* createHuffContext(void) {
+    HuffContext* ctx = (HuffContext*)calloc(1, sizeof(HuffContext));
+    if (!ctx) {
+        perror("malloc error (createHuffContext)");
+        return NULL;
+    }
+    initBitWriterMemory(&ctx->out, IO_BUFFER_SIZE);
+    return ctx;
+}
+
+long long contextCompress(HuffContext* ctx, const unsigned char* src, size_t srcSize, const unsigned char** out) {
+    HuffContext* previous = activeContext;
+    activeContext = ctx;
+    beginStats(1);
+
+    // A writer that ran out of memory drops its output: start afresh
+    if (ctx->out.failed) {
+        freeBitWriter(&ctx->out);
+        initBitWriterMemory(&ctx->out, IO_BUFFER_SIZE);
+    }
+    ctx->out.pos = 0;
+    reserveBytes(&ctx->out, compressBufferBound(srcSize)); // Grows once, then stays
+    compressData(src, srcSize, &ctx->out);
+
+    int failed = ctx->out.failed;
+    endStats(srcSize, failed ? 0 : ctx->out.pos);
+    activeContext = previous;
+    if (failed) return -1;
+    *out = ctx->out.buffer;
+    return (long long)ctx->out.pos;
+}
+
+long long contextDecompress(HuffContext* ctx, const unsigned char* src, size_t srcSize, const unsigned char** out) {
+    unsigned int magic;
+    unsigned long long total;
+    if (readBufferHeader(src, srcSize, &magic, &total) != 0 || total > (size_t)-1 - 1) {
+        fprintf(stderr, "Error: Not a valid compressed buffer or buffer is corrupted.\n");
+        return -1;
+    }
+    if (total + 1 > ctx->decodedCapacity) {
+        free(ctx->decoded);
+        ctx->decodedCapacity = (size_t)total + 1;
+        ctx->decoded = (unsigned char*)malloc(ctx->decodedCapacity);
+        if (!ctx->decoded) {
+            perror("malloc error (contextDecompress)");
+            ctx->decodedCapacity = 0;
+            return -1;
+        }
+    }
+
+    HuffContext* previous = activeContext;
+    activeContext = ctx;
+    beginStats(0);
+    int rc = decodeBuffer(src, srcSize, magic, total, ctx->decoded);
+    endStats(srcSize, rc == 0 ? total : 0);
+    activeContext = previous;
+
+    if (rc != 0) {
+        fprintf(stderr, "Error: Compressed data is truncated or corrupted.\n");
+        return -1;
+    }
+    *out = ctx->decoded;
+    return (long long)total;
+}
+
+int contextCompressFile(HuffContext* ctx, const char* inputPath, const char* outputPath) {
+    HuffContext* previous = activeContext;
+    activeContext = ctx;
+    int rc = compressFile(inputPath, outputPath);
+    activeContext = previous;
+    return rc;
+}
+
+int contextDecompressFile(HuffContext* ctx, const char* inputPath, const char* outputPath) {
+    HuffContext* previous = activeContext;
+    activeContext = ctx;
+    int rc = decompressFile(inputPath, outputPath);
+    activeContext = previous;
+    return rc;
+}
+
+void freeHuffContext(HuffContext* ctx) {
+    if (!ctx) return;
+    if (ctx->pool) freeThreadPool(ctx->pool);
+    freeDecodeTable(ctx->table);
+    freeBitWriter(&ctx->out);
+    free(ctx->decoded);
+    free(ctx);
+}
+
+// --- Batch API ---
+
+typedef enum BatchOperation {
+    BATCH_COMPRESS_FILES,
+    BATCH_DECOMPRESS_FILES,
+    BATCH_COMPRESS_BUFFERS,
+    BATCH_DECOMPRESS_BUFFERS
+} BatchOperation;
+
+// One batch call: the items, and the next one to hand to a worker
+typedef struct Batch {
+    BatchOperation operation;
+    int count;
+    const char* const* inputPaths;   // File batches
+    const char* const* outputPaths;
+    const unsigned char* const* srcs; // Buffer batches
+    const size_t* srcSizes;
+    unsigned char** outputs;
+    size_t* outputSizes;
+    int* results;
+    int next;
+    int failed;
+    pthread_mutex_t lock;
+} Batch;
+
+// Runs on each worker of a batch: takes items until none are left, all
+// on one quiet context (none, if it cannot be allocated: the other
+// workers take the items)
+static void runBatchWorker(void* arg) {
+    Batch* batch = (Batch*)arg;
+    HuffContext* ctx = createHuffContext();
+    if (!ctx) return;
+    ctx->quiet = 1;
+    ctx->maxPoolThreads = 1; // The batch is what runs in parallel, not the blocks
+    activeContext = ctx;
+
+    for (;;) {
+        pthread_mutex_lock(&batch->lock);
+        int i = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+        if (i >= batch->count) break;
+
+        int rc;
+        switch (batch->operation) {
+            case BATCH_COMPRESS_FILES:
+                rc = runCompressFile(batch->inputPaths[i], batch->outputPaths[i]);
+                break;
+            case BATCH_DECOMPRESS_FILES:
+                rc = runDecompressFile(batch->inputPaths[i], batch->outputPaths[i]);
+                break;
+            case BATCH_COMPRESS_BUFFERS:
+                batch->outputs[i] = compressBufferAlloc(batch->srcs[i], batch->srcSizes[i], &batch->outputSizes[i]);
+                rc = batch->outputs[i] ? 0 : -1;
+                break;
+            default:
+                batch->outputs[i] = decompressBufferAlloc(batch->srcs[i], batch->srcSizes[i], &batch->outputSizes[i]);
+                rc = batch->outputs[i] ? 0 : -1;
+                break;
+        }
+        if (batch->results) batch->results[i] = rc;
+        if (rc != 0) {
+            pthread_mutex_lock(&batch->lock);
+            batch->failed++;
+            pthread_mutex_unlock(&batch->lock);
+        }
+    }
+
+    activeContext = NULL;
+    freeHuffContext(ctx);
+}
+
+// Runs every item of 'batch' on a pool of its own. Returns the number of
+// failed items.
+static int runBatch(Batch* batch, int threads) {
+    if (batch->count <= 0) return 0;
+    if (threads <= 0) threads = onlineCpuCount();
+    if (threads > batch->count) threads = batch->count;
+    batch->next = 0;
+    batch->failed = 0;
+    pthread_mutex_init(&batch->lock, NULL);
+
+    // Without threads, the calling thread works through the items
+    ThreadPool* pool = createThreadPool(threads);
+    if (pool) {
+        for (int t = 0; t < threads; ++t) {
+            if (submitJob(pool, runBatchWorker, batch) != 0) runBatchWorker(batch);
+        }
+        waitForJobs(pool);
+        freeThreadPool(pool);
+    } else {
+        runBatchWorker(batch);
+    }
+
+    // Items no worker could take (every context failed to allocate)
+    for (int i = batch->next; i < batch->count; ++i) {
+        if (batch->results) batch->results[i] = -1;
+        if (batch->outputs) batch->outputs[i] = NULL;
+        batch->failed++;
+    }
+
+    pthread_mutex_destroy(&batch->lock);
+    return batch->failed;
+}
+
+int compressFiles(const char* const* inputPaths, const char* const* outputPaths, int count, int threads,
+                  int* results) {
+    Batch batch = {.operation = BATCH_COMPRESS_FILES, .count = count, .inputPaths = inputPaths,
+                   .outputPaths = outputPaths, .results = results};
+    return runBatch(&batch, threads);
+}
+
+int decompressFiles(const char* const* inputPaths, const char* const* outputPaths, int count, int threads,
+                    int* results) {
+    Batch batch = {.operation = BATCH_DECOMPRESS_FILES, .count = count, .inputPaths = inputPaths,
+                   .outputPaths = outputPaths, .results = results};
+    return runBatch(&batch, threads);
+}
+
+int compressBuffers(const unsigned char* const* srcs, const size_t* srcSizes, int count, int threads,
+                    unsigned char** outputs, size_t* outputSizes) {
+    Batch batch = {.operation = BATCH_COMPRESS_BUFFERS, .count = count, .srcs = srcs, .srcSizes = srcSizes,
+                   .outputs = outputs, .outputSizes = outputSizes};
+    return runBatch(&batch, threads);
+}
+
+int decompressBuffers(const unsigned char* const* srcs, const size_t* srcSizes, int count, int threads,
+                      unsigned char** outputs, size_t* outputSizes) {
+    Batch batch = {.operation = BATCH_DECOMPRESS_BUFFERS, .count = count, .srcs = srcs, .srcSizes = srcSizes,
+                   .outputs = outputs, .outputSizes = outputSizes};
+    return runBatch(&batch, threads);
+}
+
+
+// --- Public API Functions (for Python ctypes) ---
+
+int api_compress_file(const char* inputPath, const char* outputPath) {
+    return compressFile(inputPath, outputPath);
+}
+
+int api_decompress_file(const char* inputPath, const char* outputPath) {
+    return decompressFile(inputPath, outputPath);
+}
+
+int api_set_decoder(int mode) {
+    if (mode != DECODER_TREE && mode != DECODER_TABLE) {
+        fprintf(stderr, "API: Unknown decoder mode %d\n", mode);
+        return -1;
+    }
+    setDecoderMode((DecoderMode)mode);
+    return 0;
+}
+
+int api_count_frequencies(const char* inputPath, unsigned long long* freqTable) {
+    FILE *in = fopen(inputPath, "rb");
+    if (!in) {
+        perror("API: Failed to open input file");
+        return -1;
+    }
+    memset(freqTable, 0, NUM_CHARS * sizeof(unsigned long long));
+    countStreamFrequencies(in, freqTable);
+    int failed = ferror(in);
+    fclose(in);
+    return failed ? -1 : 0;
+}
+
+int api_set_block_mode(unsigned long long blockSize, int threads) {
+    if (blockSize > HUFF_MAX_BLOCK_SIZE || threads < 0) {
+        fprintf(stderr, "API: Invalid block mode (block size %llu, threads %d)\n", blockSize, threads);
+        return -1;
+    }
+    setBlockSize((size_t)blockSize);
+    setThreadCount(threads);
+    return 0;
+}
+
+int api_set_stream_count(int streams) {
+    if (streams != 1 && streams != HUFF_INTERLEAVED_STREAMS) {
+        fprintf(stderr, "API: Invalid stream count %d\n", streams);
+        return -1;
+    }
+    setStreamCount(streams);
+    return 0;
+}
+
+int api_set_max_code_length(int length) {
+    if (length < HUFF_MIN_CODE_LENGTH_LIMIT || length > HUFF_MAX_CODE_LENGTH) {
+        fprintf(stderr, "API: Invalid maximum code length %d\n", length);
+        return -1;
+    }
+    setMaxCodeLength(length);
+    return 0;
+}
+
+long long api_train_dictionary(const unsigned char* samples, size_t size, unsigned id, const char* outputPath) {
+    if ((!samples && size > 0) || !outputPath) {
+        fprintf(stderr, "API: Invalid dictionary training arguments\n");
+        return -1;
+    }
+    return trainDictionary(samples, size, id, outputPath);
+}
+
+long long api_load_dictionary(const char* path) {
+    if (!path) {
+        fprintf(stderr, "API: Invalid dictionary path\n");
+        return -1;
+    }
+    return loadDictionary(path);
+}
+
+int api_set_dictionary(unsigned id) {
+    if (id != 0 && !hasDictionary(id)) {
+        fprintf(stderr, "API: Unknown dictionary %u\n", id);
+        return -1;
+    }
+    setDictionary(id);
+    return 0;
+}
+
+int api_extract_range(const char* inputPath, const char* outputPath,
+                      unsigned long long offset, unsigned long long length) {
+    return extractRange(inputPath, outputPath, offset, length);
+}
+
+long long api_read_range(const char* inputPath, unsigned long long offset,
+                         unsigned long long length, unsigned char* dest) {
+    return readRange(inputPath, offset, length, dest);
+}
+
+size_t api_compress_bound(size_t size) {
+    return compressBufferBound(size);
+}
+
+long long api_compress_buffer(const unsigned char* src, size_t srcSize,
+                              unsigned char* dest, size_t destCapacity) {
+    return compressBuffer(src, srcSize, dest, destCapacity);
+}
+
+long long api_decompressed_size(const unsigned char* src, size_t srcSize) {
+    return decompressedSize(src, srcSize);
+}
+
+long long api_decompress_buffer(const unsigned char* src, size_t srcSize,
+                                unsigned char* dest, size_t destCapacity) {
+    return decompressBuffer(src, srcSize, dest, destCapacity);
+}
+
+unsigned char* api_compress_buffer_alloc(const unsigned char* src, size_t srcSize, size_t* destSize) {
+    return compressBufferAlloc(src, srcSize, destSize);
+}
+
+unsigned char* api_decompress_buffer_alloc(const unsigned char* src, size_t srcSize, size_t* destSize) {
+    return decompressBufferAlloc(src, srcSize, destSize);
+}
+
+void api_free_buffer(unsigned char* buffer) {
+    free(buffer);
+}
+
+size_t api_compress_shuffled_bound(size_t size, size_t elementSize) {
+    return compressShuffledBound(size, elementSize);
+}
+
+long long api_compress_shuffled(const unsigned char* src, size_t srcSize, size_t elementSize,
+                                unsigned char* dest, size_t destCapacity) {
+    return compressShuffled(src, srcSize, elementSize, dest, destCapacity);
+}
+
+HuffContext* api_context_create(void) {
+    return createHuffContext();
+}
+
+long long api_context_compress(HuffContext* ctx, const unsigned char* src, size_t srcSize,
+                               const unsigned char** out) {
+    if (!ctx) {
+        fprintf(stderr, "API: Invalid context\n");
+        return -1;
+    }
+    return contextCompress(ctx, src, srcSize, out);
+}
+
+long long api_context_decompress(HuffContext* ctx, const unsigned char* src, size_t srcSize,
+                                 const unsigned char** out) {
+    if (!ctx) {
+        fprintf(stderr, "API: Invalid context\n");
+        return -1;
+    }
+    return contextDecompress(ctx, src, srcSize, out);
+}
+
+int api_context_compress_file(HuffContext* ctx, const char* inputPath, const char* outputPath) {
+    if (!ctx) {
+        fprintf(stderr, "API: Invalid context\n");
+        return -1;
+    }
+    return contextCompressFile(ctx, inputPath, outputPath);
+}
+
+int api_context_decompress_file(HuffContext* ctx, const char* inputPath, const char* outputPath) {
+    if (!ctx) {
+        fprintf(stderr, "API: Invalid context\n");
+        return -1;
+    }
+    return contextDecompressFile(ctx, inputPath, outputPath);
+}
+
+void api_context_free(HuffContext* ctx) {
+    freeHuffContext(ctx);
+}
+
+int api_compress_files(const char* const* inputPaths, const char* const* outputPaths, int count, int threads,
+                       int* results) {
+    if (count < 0 || (count > 0 && (!inputPaths || !outputPaths))) {
+        fprintf(stderr, "API: Invalid file batch\n");
+        return -1;
+    }
+    return compressFiles(inputPaths, outputPaths, count, threads, results);
+}
+
+int api_decompress_files(const char* const* inputPaths, const char* const* outputPaths, int count, int threads,
+                         int* results) {
+    if (count < 0 || (count > 0 && (!inputPaths || !outputPaths))) {
+        fprintf(stderr, "API: Invalid file batch\n");
+        return -1;
+    }
+    return decompressFiles(inputPaths, outputPaths, count, threads, results);
+}
+
+int api_compress_buffers(const unsigned char* const* srcs, const size_t* srcSizes, int count, int threads,
+                         unsigned char** outputs, size_t* outputSizes) {
+    if (count < 0 || (count > 0 && (!srcs || !srcSizes || !outputs || !outputSizes))) {
+        fprintf(stderr, "API: Invalid buffer batch\n");
+        return -1;
+    }
+    return compressBuffers(srcs, srcSizes, count, threads, outputs, outputSizes);
+}
+
+int api_decompress_buffers(const unsigned char* const* srcs, const size_t* srcSizes, int count, int threads,
+                           unsigned char** outputs, size_t* outputSizes) {
+    if (count < 0 || (count > 0 && (!srcs || !srcSizes || !outputs || !outputSizes))) {
+        fprintf(stderr, "API: Invalid buffer batch\n");
+        return -1;
+    }
+    return decompressBuffers(srcs, srcSizes, count, threads, outputs, outputSizes);
+}
+
+CompressStream* api_compress_stream_create(unsigned long long blockSize) {
+    if (blockSize > HUFF_MAX_BLOCK_SIZE) {
+        fprintf(stderr, "API: Invalid block size %llu\n", blockSize);
+        return NULL;
+    }
+    return createCompressStream((size_t)blockSize);
+}
+
+long long api_compress_stream_feed(CompressStream* stream, const unsigned char* data, size_t size,
+                                   const unsigned char** out) {
+    return compressStreamFeed(stream, data, size, out);
+}
+
+long long api_compress_stream_flush(CompressStream* stream, const unsigned char** out) {
+    return compressStreamFlush(stream, out);
+}
+
+long long api_compress_stream_end(CompressStream* stream, const unsigned char** out) {
+    return compressStreamEnd(stream, out);
+}
+
+void api_compress_stream_free(CompressStream* stream) {
+    freeCompressStream(stream);
+}
+
+DecompressStream* api_decompress_stream_create(void) {
+    return createDecompressStream();
+}
+
+long long api_decompress_stream_feed(DecompressStream* stream, const unsigned char* data, size_t size,
+                                     const unsigned char** out) {
+    return decompressStreamFeed(stream, data, size, out);
+}
+
+int api_decompress_stream_end(DecompressStream* stream) {
+    return decompressStreamEnd(stream);
+}
+
+void api_decompress_stream_free(DecompressStream* stream) {
+    freeDecompressStream(stream);
 }
@@ -3,58 +3,350 @@
 
 // Include standard libraries needed for types (size_t) and (NULL)
 #include <stddef.h> 
+#include <stdio.h>  // FILE
 
 // --- Data Structures ---
 
-// A node in the Huffman Tree
+#define HUFF_TREE_MAX_NODES 511 // 256 leaves and 255 internal nodes
+#define HUFF_TREE_NONE 0xFFFF   // Index of a missing child (or of the root of an empty tree)
+
+// A node in the Huffman Tree, stored in a HuffTree's node array
 // Note: 'unsigned char' is used for 'data' to handle all 256 possible byte values.
 typedef struct Node {
-    unsigned char data;        // Character (for leaf nodes)
-    unsigned long long freq;   // Frequency of the character (use long long for large files)
-    struct Node *left, *right; // Left and right children
+    unsigned long long freq;    // Frequency of the character (use long long for large files)
+    unsigned short left, right; // Indices of the left and right children (HUFF_TREE_NONE if absent)
+    unsigned char data;         // Character (for leaf nodes)
 } Node;
 
-// A node for the Min Heap
-// This wraps a Huffman Tree node to be used in the heap
-typedef struct MinHeapNode {
-    Node* huffmanNode;
-} MinHeapNode;
+// A whole Huffman tree in one fixed array, so building or dropping a tree
+// never goes through the allocator
+typedef struct HuffTree {
+    Node nodes[HUFF_TREE_MAX_NODES];
+    unsigned short count; // Nodes in use
+    unsigned short root;  // HUFF_TREE_NONE while the tree is empty
+} HuffTree;
 
-// The Min Heap
+// The Min Heap: indices of tree nodes, ordered by frequency
 typedef struct MinHeap {
-    unsigned size;     // Current size of heap
-    unsigned capacity; // Capacity of heap
-    MinHeapNode** array; // Array of MinHeapNode pointers
+    unsigned size;              // Current size of heap
+    unsigned short array[256];  // Node indices
 } MinHeap;
 
+// A Huffman code as an integer: the low 'length' bits of 'bits', sent MSB first
+typedef struct HuffCode {
+    unsigned long long bits;
+    unsigned char length;
+} HuffCode;
+
+// Longest code the canonical format can describe (lengths are stored as nibbles)
+#define HUFF_MAX_CODE_LENGTH 15
+// Bit streams per block in interleaved block mode
+#define HUFF_INTERLEAVED_STREAMS 4
+
+// Shortest length limit that still leaves room for all 256 byte values
+#define HUFF_MIN_CODE_LENGTH_LIMIT 8
+
+// Block container limits (block sizes are in bytes of uncompressed input)
+#define HUFF_DEFAULT_BLOCK_SIZE (1024 * 1024)
+#define HUFF_MAX_BLOCK_SIZE (1024 * 1024 * 1024)
+
+// Dictionaries that can be registered at once
+#define HUFF_MAX_DICTIONARIES 64
+
+// Widest element a shuffled buffer can hold (see compressShuffled)
+#define HUFF_MAX_ELEMENT_SIZE 256
+
+// --- Table-Driven Decoder ---
+
+// Width of the primary decode table and the maximum width of a secondary
+// table. Codes longer than DECODE_PRIMARY_BITS + DECODE_SECONDARY_BITS
+// escape to the tree and finish decoding bit by bit.
+#define DECODE_PRIMARY_BITS 11
+#define DECODE_SECONDARY_BITS 12
+
+// Values of DecodeEntry.count that are not a symbol count
+#define DECODE_INVALID 0   // No code starts with these bits (corrupt input)
+#define DECODE_LINK 3      // Continue in a secondary table
+#define DECODE_ESCAPE 4    // Continue walking the tree from escapes[symbols]
+
+// One slot of a decode table, indexed by the next N bits of input.
+typedef struct DecodeEntry {
+    unsigned short symbols; // First symbol in the low byte, second in the high byte
+                            // (secondary table number or escape index for links)
+    unsigned char bits;     // Input bits consumed (secondary table width for links)
+    unsigned char count;    // Whole symbols emitted (1 or 2), or a DECODE_* marker
+} DecodeEntry;
+
+// Lookup tables built from a Huffman tree.
+// Each primary probe emits one or two whole symbols for codes that fit in
+// DECODE_PRIMARY_BITS; longer codes go through a secondary table.
+typedef struct DecodeTable {
+    DecodeEntry primary[1 << DECODE_PRIMARY_BITS];
+    DecodeEntry* secondary;      // All secondary tables, stored back to back
+    unsigned* secondaryOffset;   // Start of each secondary table in 'secondary'
+    unsigned secondaryCount;     // Number of secondary tables
+    unsigned secondarySize;      // Number of entries in 'secondary'
+    const HuffTree* tree;        // Tree the escapes continue in (tables built from a tree)
+    unsigned short escapes[256]; // Tree nodes for codes longer than the tables
+    unsigned escapeCount;
+    unsigned char pairFirstBits[256]; // Code length of each symbol that starts a pair entry
+} DecodeTable;
+
+// Stages timed in HuffStats.stageNs
+typedef enum HuffStage {
+    HUFF_STAGE_READ = 0,  // Mapping or reading the input
+    HUFF_STAGE_HISTOGRAM, // Counting byte frequencies
+    HUFF_STAGE_TREE,      // Code lengths (the Huffman tree)
+    HUFF_STAGE_CODES,     // Canonical codes and decode tables
+    HUFF_STAGE_HEADER,    // Writing or parsing headers and code lengths
+    HUFF_STAGE_BITS,      // Packing or decoding the bit stream
+    HUFF_STAGE_WRITE,     // Writing the output
+    HUFF_STAGE_COUNT
+} HuffStage;
+
+// What one compression or decompression call did (see setStatsTarget).
+// Times are wall-clock nanoseconds. In block mode the blocks are coded on
+// several threads at once, so the stage times can add up to more than
+// totalNs.
+typedef struct HuffStats {
+    int compress;                 // 1 for a compression, 0 for a decompression
+    unsigned long long stageNs[HUFF_STAGE_COUNT];
+    unsigned long long totalNs;
+    unsigned long long bytesIn, bytesOut;
+    unsigned long long symbols;   // Bytes of original data
+    unsigned long long codedBits; // Size of the coded data, without headers
+    unsigned blocks;              // Coded blocks (1 for a single stream)
+    unsigned distinctSymbols;     // Byte values in use (the most in any one block)
+    unsigned treeDepth;           // Longest code
+    double averageCodeLength;     // codedBits per symbol
+    double entropy;               // Order-0 entropy in bits per symbol, per block
+                                  // (compression only): the bound for averageCodeLength
+    double entropyBits;           // Entropy of all the blocks, in bits
+    unsigned long long readCalls; // Input buffer reads
+    unsigned long long writeCalls; // Output buffer writes
+    unsigned long long mapCalls;  // mmap calls
+} HuffStats;
+
+// Which decoder decompressFile uses
+typedef enum DecoderMode {
+    DECODER_TREE = 0,  // Walk the tree one bit at a time
+    DECODER_TABLE = 1  // Multi-bit table lookups (default)
+} DecoderMode;
+
 
 // Core Logic Prototypes (Internal to huffman.c) ---
 
 // (These are the helper functions you will implement in huffman.c)
 
 // Node utility
-Node* createNode(unsigned char data, unsigned long long freq);
+void initTree(HuffTree* tree);
+// Adds a node without children. Returns its index, or HUFF_TREE_NONE if the tree is full.
+unsigned short createNode(HuffTree* tree, unsigned char data, unsigned long long freq);
 
-// MinHeap utilities
-MinHeap* createMinHeap(unsigned capacity);
-void swapMinHeapNode(MinHeapNode** a, MinHeapNode** b);
-void minHeapify(MinHeap* minHeap, int idx);
-Node* extractMin(MinHeap* minHeap);
-void insertMinHeap(MinHeap* minHeap, Node* huffmanNode);
-void buildMinHeap(MinHeap* minHeap);
-int isMinHeapSizeOne(MinHeap* minHeap);
+// MinHeap utilities (the heap orders nodes of 'tree')
+void swapMinHeapNode(unsigned short* a, unsigned short* b);
+void minHeapify(const HuffTree* tree, MinHeap* minHeap, unsigned idx);
+unsigned short extractMin(const HuffTree* tree, MinHeap* minHeap);
+void insertMinHeap(const HuffTree* tree, MinHeap* minHeap, unsigned short node);
+void buildMinHeap(const HuffTree* tree, MinHeap* minHeap);
+int isMinHeapSizeOne(const MinHeap* minHeap);
 
 // Huffman Tree utilities
-Node* buildHuffmanTree(unsigned long long freqTable[]);
-int isLeaf(Node* root);
-void freeTree(Node* root);
+// Builds the tree for a histogram in 'tree'. Returns 0, or -1 if every frequency is 0.
+int buildHuffmanTree(const unsigned long long freqTable[], HuffTree* tree);
+int isLeaf(const Node* node);
+
+// Frequency counting utilities
+// Adds the byte counts of data[0..size) to freqTable.
+void countFrequencies(const unsigned char* data, size_t size, unsigned long long freqTable[256]);
+// Adds the byte counts of the rest of a stream to freqTable. Returns the
+// number of bytes read.
+unsigned long long countStreamFrequencies(FILE* in, unsigned long long freqTable[256]);
+
+// Code generation utilities. Return 0, or -1 on an allocation failure
+// (generateCodes) or a code longer than 64 bits (generateCodeTable).
+int generateCodes(const HuffTree* tree, unsigned short node, char* codeMap[256], char buffer[], int top);
+int generateCodeTable(const HuffTree* tree, unsigned short node, HuffCode codes[256],
+                      unsigned long long code, int length);
+
+// Canonical code utilities
+void computeCodeLengths(const unsigned long long freqTable[256], unsigned char lengths[256], int maxLength);
+void assignCanonicalCodes(const unsigned char lengths[256], HuffCode codes[256]);
+// Rebuilds a tree from canonical codes, for the bit-by-bit decoder.
+// Returns 0, or -1 if the codes need more than HUFF_TREE_MAX_NODES nodes.
+int buildCanonicalTree(const HuffCode codes[256], HuffTree* tree);
+
+// Decode table utilities. The builders return NULL if memory runs out.
+// The table points into 'tree' for long codes, so the tree must outlive it
+DecodeTable* buildDecodeTable(const HuffTree* tree);
+DecodeTable* buildDecodeTableFromCodes(const HuffCode codes[256]);
+void freeDecodeTable(DecodeTable* table);
+
+// --- Settings ---
+// The decoder, block size, thread count, stream count, maximum code length
+// and dictionary below are process-wide and read without locks by every
+// call, including contexts, streams and batch workers. Set them up front:
+// changing one while a call is running on another thread is a data race.
+void setDecoderMode(DecoderMode mode);
+DecoderMode getDecoderMode(void);
+
+// Block mode settings: a block size of 0 writes a single stream, and
+// 0 threads uses one worker per online CPU
+void setBlockSize(size_t size);
+size_t getBlockSize(void);
+void setThreadCount(int threads);
+int getThreadCount(void);
+
+// Bit streams per block: 1, or HUFF_INTERLEAVED_STREAMS to code each
+// quarter of a block to its own stream so the decoder can work on four at
+// once. Only used in block mode.
+void setStreamCount(int streams);
+int getStreamCount(void);
+
+// Kernels picked for this CPU at startup: "avx2", "sse2" or "portable"
+const char* getKernelName(void);
+
+// Longest code the encoder may assign, from HUFF_MIN_CODE_LENGTH_LIMIT to
+// HUFF_MAX_CODE_LENGTH (the default). Lengths are optimal under the limit.
+// With DECODE_PRIMARY_BITS (11) or less every code decodes in one table probe.
+void setMaxCodeLength(int length);
+int getMaxCodeLength(void);
+
+// --- Dictionaries ---
+// A dictionary is a code trained on a sample corpus and shared by writer
+// and reader, so a message's header names it by ID instead of carrying
+// its own table. Meant for many small messages with one byte distribution.
+// Training gives every byte value a code, so any data can be coded with it.
+// trainDictionary(FromFiles) saves the dictionary to outputPath and
+// registers it; ID 0 derives the ID from the code. They return the ID,
+// or -1 on error.
+long long trainDictionary(const unsigned char* samples, size_t size, unsigned id, const char* outputPath);
+long long trainDictionaryFromFiles(const char* const* samplePaths, int count, unsigned id, const char* outputPath);
+// Registers a saved dictionary. Returns its ID, or -1 on error.
+long long loadDictionary(const char* path);
+// Registers code lengths under 'id' (replacing a dictionary with that ID).
+// Returns 0, or -1 if the lengths are not a valid code or the registry is full.
+int registerDictionary(unsigned id, const unsigned char lengths[256]);
+int hasDictionary(unsigned id);
+// Unregisters every dictionary and clears the current one
+void clearDictionaries(void);
+// Dictionary single-stream compression uses (0, the default, for none).
+// Block mode keeps its per-block tables. Decompression finds the
+// dictionary from the ID in the header, so it must be registered.
+void setDictionary(unsigned id);
+unsigned getDictionary(void);
+
+// Main File I/O Functions. Return 0 on success, -1 on error (a failed
+// decode removes its partial output).
+int compressFile(const char* inputPath, const char* outputPath);
+int decompressFile(const char* inputPath, const char* outputPath);
 
-// Code generation utilities
-void generateCodes(Node* root, char* codeMap[256], char buffer[], int top);
+// Statistics: while a target is set, every compressFile, decompressFile,
+// compressBuffer(Alloc) and decompressBuffer(Alloc) call made from this
+// thread clears *stats and fills it (partly, if the call fails). Stream
+// contexts add their blocks to it without clearing it. NULL (the default)
+// turns collection off, which leaves the hot loops untimed.
+void setStatsTarget(HuffStats* stats);
+HuffStats* getStatsTarget(void);
+// Short name of a stage, e.g. "histogram"
+const char* huffStageName(HuffStage stage);
 
-// Main File I/O Functions
-void compressFile(const char* inputPath, const char* outputPath);
-void decompressFile(const char* inputPath, const char* outputPath);
+// Random access: bytes [offset, offset + length) of the original data,
+// clamped to its end. Block containers decode only the covering blocks;
+// single-stream files decode from the start. Shuffled arrays are not
+// supported.
+// readRange returns the number of bytes copied to dest, or -1 on error.
+long long readRange(const char* inputPath, unsigned long long offset, unsigned long long length,
+                    unsigned char* dest);
+// extractRange writes the bytes to outputPath. Returns 0 on success, -1 on error.
+int extractRange(const char* inputPath, const char* outputPath, unsigned long long offset,
+                 unsigned long long length);
+
+// --- Buffer API ---
+// The same formats as the files, without touching the file system.
+// compressBufferBound gives the largest output for 'size' input bytes with
+// the current block settings; compressBuffer fails (-1) on a smaller buffer.
+size_t compressBufferBound(size_t size);
+long long compressBuffer(const unsigned char* src, size_t srcSize, unsigned char* dest, size_t destCapacity);
+// Original size stored in a compressed buffer's header, or -1 if it is not one
+long long decompressedSize(const unsigned char* src, size_t srcSize);
+long long decompressBuffer(const unsigned char* src, size_t srcSize, unsigned char* dest, size_t destCapacity);
+// Variants returning a malloc'd buffer (NULL on error) and its size in *destSize
+unsigned char* compressBufferAlloc(const unsigned char* src, size_t srcSize, size_t* destSize);
+unsigned char* decompressBufferAlloc(const unsigned char* src, size_t srcSize, size_t* destSize);
+// Arrays of fixed-width elements: the bytes are split into byte planes
+// (byte k of every element) and each plane is coded as a block with its
+// own table. decompressBuffer restores them.
+size_t compressShuffledBound(size_t size, size_t elementSize);
+long long compressShuffled(const unsigned char* src, size_t srcSize, size_t elementSize, unsigned char* dest,
+                           size_t destCapacity);
+
+// --- Streaming API ---
+// Incremental compression of input of unknown length (pipes, sockets):
+// data is cut into blocks as it arrives, each with its own table, so memory
+// stays bounded by the block size. The output is a block container whose
+// char count is filled in by readers from the block headers.
+// Every call returns the size of the output it produced and sets *out to it
+// (valid until the next call on the same stream), or returns -1 on error.
+// The create functions return NULL if memory runs out.
+typedef struct CompressStream CompressStream;
+CompressStream* createCompressStream(size_t blockSize); // 0 = HUFF_DEFAULT_BLOCK_SIZE
+long long compressStreamFeed(CompressStream* stream, const unsigned char* data, size_t size,
+                             const unsigned char** out);
+// Codes the data fed so far as a (short) block, so a reader can decode all of it
+long long compressStreamFlush(CompressStream* stream, const unsigned char** out);
+// Flushes and writes the end marker; the stream takes no more input
+long long compressStreamEnd(CompressStream* stream, const unsigned char** out);
+void freeCompressStream(CompressStream* stream);
+
+// Incremental decompression of block containers, streamed or not. Blocks
+// are decoded as soon as all of their bytes have been fed.
+typedef struct DecompressStream DecompressStream;
+DecompressStream* createDecompressStream(void);
+long long decompressStreamFeed(DecompressStream* stream, const unsigned char* data, size_t size,
+                               const unsigned char** out);
+// Returns 0 if the whole container was fed, -1 if it was truncated or corrupt
+int decompressStreamEnd(DecompressStream* stream);
+void freeDecompressStream(DecompressStream* stream);
+
+// --- Compression Context ---
+// Keeps what every call would otherwise set up and free again: the worker
+// pool of block mode, decode tables and the output buffers. Reusing one
+// context for many small messages leaves little beyond the coding itself.
+// Calls use the current settings (which must not change while a call is
+// running, see Settings). A context is used by one thread at a time; use
+// one per thread.
+typedef struct HuffContext HuffContext;
+HuffContext* createHuffContext(void); // NULL if memory runs out
+// The buffer API with output kept in the context: returns the output size
+// and sets *out to it (valid until the next call on the context), or
+// returns -1 on error
+long long contextCompress(HuffContext* ctx, const unsigned char* src, size_t srcSize, const unsigned char** out);
+long long contextDecompress(HuffContext* ctx, const unsigned char* src, size_t srcSize, const unsigned char** out);
+// compressFile and decompressFile on the context's worker pool
+int contextCompressFile(HuffContext* ctx, const char* inputPath, const char* outputPath);
+int contextDecompressFile(HuffContext* ctx, const char* inputPath, const char* outputPath);
+void freeHuffContext(HuffContext* ctx);
+
+// --- Batch API ---
+// Many independent items in one call, on a worker pool of the batch's own
+// ('threads' workers, 0 for one per online CPU). Each worker takes items
+// until none are left, with a context kept across them and no progress
+// messages. Items use the current settings, which must not change until
+// the batch returns (see Settings); in block mode an item's blocks
+// stay on its worker, since the batch already keeps every core busy.
+// All return the number of failed items.
+// File batches set results[i] (if results is not NULL) to 0 or -1.
+int compressFiles(const char* const* inputPaths, const char* const* outputPaths, int count, int threads,
+                  int* results);
+int decompressFiles(const char* const* inputPaths, const char* const* outputPaths, int count, int threads,
+                    int* results);
+// Buffer batches set outputs[i] to a malloc'd buffer of outputSizes[i]
+// bytes, or to NULL if item i failed
+int compressBuffers(const unsigned char* const* srcs, const size_t* srcSizes, int count, int threads,
+                    unsigned char** outputs, size_t* outputSizes);
+int decompressBuffers(const unsigned char* const* srcs, const size_t* srcSizes, int count, int threads,
+                      unsigned char** outputs, size_t* outputSizes);
 
 
 // --- Public API Functions (for Python ctypes) ---
@@ -70,6 +362,116 @@ int api_compress_file(const char* inputPath, const char* outputPath);
 // Decompresses a file. Returns 0 on success, -1 on error.
 int api_decompress_file(const char* inputPath, const char* outputPath);
 
+// Fills freqTable (256 entries) with the byte counts of a file.
+// Returns 0 on success, -1 on error.
+int api_count_frequencies(const char* inputPath, unsigned long long* freqTable);
+
+// Selects the decoder (0 = tree walk, 1 = table). Returns 0 on success, -1 on error.
+int api_set_decoder(int mode);
+
+// Writes bytes [offset, offset + length) of the original data to outputPath.
+// Returns 0 on success, -1 on error.
+int api_extract_range(const char* inputPath, const char* outputPath,
+                      unsigned long long offset, unsigned long long length);
+
+// Copies bytes [offset, offset + length) of the original data into dest (which must
+// hold 'length' bytes). Returns the number of bytes copied, or -1 on error.
+long long api_read_range(const char* inputPath, unsigned long long offset,
+                         unsigned long long length, unsigned char* dest);
+
+// Largest compressed size of 'size' bytes with the current block settings
+size_t api_compress_bound(size_t size);
+
+// Compresses src into dest (at least api_compress_bound(srcSize) bytes to be safe).
+// Returns the compressed size, or -1 on error.
+long long api_compress_buffer(const unsigned char* src, size_t srcSize,
+                              unsigned char* dest, size_t destCapacity);
+
+// Original size of a compressed buffer, or -1 if it is not one.
+long long api_decompressed_size(const unsigned char* src, size_t srcSize);
+
+// Decompresses src into dest (at least api_decompressed_size bytes).
+// Returns the decompressed size, or -1 on error.
+long long api_decompress_buffer(const unsigned char* src, size_t srcSize,
+                                unsigned char* dest, size_t destCapacity);
+
+// As above, into a buffer allocated by the library (release it with api_free_buffer).
+// Return NULL on error.
+unsigned char* api_compress_buffer_alloc(const unsigned char* src, size_t srcSize, size_t* destSize);
+unsigned char* api_decompress_buffer_alloc(const unsigned char* src, size_t srcSize, size_t* destSize);
+void api_free_buffer(unsigned char* buffer);
+
+// Compresses an array of 'elementSize'-byte elements by byte plane (see
+// compressShuffled). api_decompress_buffer restores it. Returns the compressed
+// size, or -1 on error.
+size_t api_compress_shuffled_bound(size_t size, size_t elementSize);
+long long api_compress_shuffled(const unsigned char* src, size_t srcSize, size_t elementSize,
+                                unsigned char* dest, size_t destCapacity);
+
+// Reusable context (see createHuffContext). Outputs are returned through *out and stay
+// valid until the next call on the context; functions return the output size, or -1 on
+// error. The file variants return 0 on success, -1 on error.
+HuffContext* api_context_create(void);
+long long api_context_compress(HuffContext* ctx, const unsigned char* src, size_t srcSize,
+                               const unsigned char** out);
+long long api_context_decompress(HuffContext* ctx, const unsigned char* src, size_t srcSize,
+                                 const unsigned char** out);
+int api_context_compress_file(HuffContext* ctx, const char* inputPath, const char* outputPath);
+int api_context_decompress_file(HuffContext* ctx, const char* inputPath, const char* outputPath);
+void api_context_free(HuffContext* ctx);
+
+// Batches (see compressFiles and compressBuffers) on a pool of 'threads' workers
+// (0 = one per CPU). They return the number of failed items, or -1 for invalid
+// arguments. Buffer outputs are released with api_free_buffer.
+int api_compress_files(const char* const* inputPaths, const char* const* outputPaths, int count, int threads,
+                       int* results);
+int api_decompress_files(const char* const* inputPaths, const char* const* outputPaths, int count, int threads,
+                         int* results);
+int api_compress_buffers(const unsigned char* const* srcs, const size_t* srcSizes, int count, int threads,
+                         unsigned char** outputs, size_t* outputSizes);
+int api_decompress_buffers(const unsigned char* const* srcs, const size_t* srcSizes, int count, int threads,
+                           unsigned char** outputs, size_t* outputSizes);
+
+// Streaming compression (see compressStreamFeed). Outputs are returned through *out and
+// stay valid until the next call; functions return the output size, or -1 on error.
+CompressStream* api_compress_stream_create(unsigned long long blockSize);
+long long api_compress_stream_feed(CompressStream* stream, const unsigned char* data, size_t size,
+                                   const unsigned char** out);
+long long api_compress_stream_flush(CompressStream* stream, const unsigned char** out);
+long long api_compress_stream_end(CompressStream* stream, const unsigned char** out);
+void api_compress_stream_free(CompressStream* stream);
+
+// Streaming decompression of block containers. api_decompress_stream_end returns 0 if
+// the whole container was fed, -1 otherwise.
+DecompressStream* api_decompress_stream_create(void);
+long long api_decompress_stream_feed(DecompressStream* stream, const unsigned char* data, size_t size,
+                                     const unsigned char** out);
+int api_decompress_stream_end(DecompressStream* stream);
+void api_decompress_stream_free(DecompressStream* stream);
+
+// Enables block mode for compression (blockSize 0 turns it off; threads 0 = one per CPU).
+// Returns 0 on success, -1 on error.
+int api_set_block_mode(unsigned long long blockSize, int threads);
+
+// Sets the bit streams per block in block mode (1 or 4).
+// Returns 0 on success, -1 on error.
+int api_set_stream_count(int streams);
+
+// Sets the longest code the encoder may assign (8 to 15 bits, default 15).
+// Returns 0 on success, -1 on error.
+int api_set_max_code_length(int length);
+
+// Trains a dictionary on samples[0..size), saves it to outputPath and registers it
+// (id 0 derives the ID from the code). Returns the ID, or -1 on error.
+long long api_train_dictionary(const unsigned char* samples, size_t size, unsigned id, const char* outputPath);
+
+// Registers a saved dictionary. Returns its ID, or -1 on error.
+long long api_load_dictionary(const char* path);
+
+// Compresses single streams with a registered dictionary (0 for none).
+// Returns 0 on success, -1 on error.
+int api_set_dictionary(unsigned id);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,33 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+
+// --- ISA-Specific Kernels ---
+// Inner loops built with their own instruction set flags (see the
+// Makefile). huffman.c checks the CPU once at startup and calls the best
+// variant the CPU supports, falling back to portable C.
+
+// Adds the byte counts of data[0..size) to freqTable. 'size' is at most
+// 2^30, so the kernels may count in 32 bits.
+typedef void (*HistogramKernel)(const unsigned char* data, size_t size, unsigned long long freqTable[256]);
+
+// A code for the packing kernels: the code bits in the low 24 bits and
+// the length (at most 15) in the top 8
+#define KERNEL_CODE(bits, length) ((unsigned)(bits) | ((unsigned)(length) << 24))
+
+// Concatenates the codes of data[0..count) four at a time (count is a
+// multiple of 4): group g holds the codes of symbols 4g to 4g + 3, first
+// symbol in the highest bits, in its low groupLengths[g] (at most 60) bits.
+typedef void (*PackCodesKernel)(const unsigned char* data, size_t count, const unsigned codes[256],
+                                unsigned long long* groups, unsigned char* groupLengths);
+
+#ifdef HUFF_AVX2_KERNELS
+// 32-byte loads; runs of one byte value are counted a whole vector at a time
+void histogramAvx2(const unsigned char* data, size_t size, unsigned long long freqTable[256]);
+// Gathers eight codes at a time and merges them in registers
+void packCodesAvx2(const unsigned char* data, size_t count, const unsigned codes[256],
+                   unsigned long long* groups, unsigned char* groupLengths);
+#endif
+
+#endif // KERNELS_H
@@ -0,0 +1,95 @@
+// AVX2 kernels. This file is built with -mavx2 and only called after the
+// CPU has been checked (see selectKernels in huffman.c).
+#include "kernels.h"
+#include <string.h>
+
+#if defined(HUFF_AVX2_KERNELS) && defined(__AVX2__)
+#include <immintrin.h>
+
+// --- Histogram ---
+
+// Spreads the bytes of each 32-byte load over 8 sub-histograms, like the
+// SSE2 version. A load that is one byte value repeated (long runs, zero
+// fill, single-symbol data) is counted with a single add instead.
+void histogramAvx2(const unsigned char* data, size_t size, unsigned long long freqTable[256]) {
+    unsigned counts[8][256];
+    memset(counts, 0, sizeof(counts));
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i first = _mm256_set1_epi8((char)data[i]);
+        if ((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, first)) == 0xFFFFFFFFu) {
+            counts[0][data[i]] += 32;
+            continue;
+        }
+        unsigned long long w[4];
+        _mm256_storeu_si256((__m256i*)w, v);
+        for (int q = 0; q < 4; ++q) {
+            for (int k = 0; k < 8; ++k) {
+                counts[k][(w[q] >> (8 * k)) & 0xFF]++;
+            }
+        }
+    }
+    for (; i < size; ++i) {
+        counts[0][data[i]]++;
+    }
+
+    for (int c = 0; c < 256; ++c) {
+        unsigned long long sum = 0;
+        for (int k = 0; k < 8; ++k) sum += counts[k][c];
+        freqTable[c] += sum;
+    }
+}
+
+// --- Code Packing ---
+
+void packCodesAvx2(const unsigned char* data, size_t count, const unsigned codes[256],
+                   unsigned long long* groups, unsigned char* groupLengths) {
+    const __m256i codeMask = _mm256_set1_epi32(0xFFFFFF);
+    const __m256i lowHalf = _mm256_set1_epi64x(0xFFFFFFFF);
+
+    size_t i = 0, g = 0;
+    for (; i + 8 <= count; i += 8, g += 2) {
+        // 1. Gather the eight codes
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(data + i)));
+        __m256i entry = _mm256_i32gather_epi32((const int*)codes, index, 4);
+        __m256i bits = _mm256_and_si256(entry, codeMask);
+        __m256i lengths = _mm256_srli_epi32(entry, 24);
+
+        // 2. Merge neighbours within each 64-bit lane: (even << odd length) | odd
+        __m256i oddLengths = _mm256_srli_epi64(lengths, 32);
+        __m256i pairs = _mm256_or_si256(_mm256_sllv_epi64(_mm256_and_si256(bits, lowHalf), oddLengths),
+                                        _mm256_srli_epi64(bits, 32));
+        __m256i pairLengths = _mm256_add_epi64(_mm256_and_si256(lengths, lowHalf), oddLengths);
+
+        // 3. Merge the pairs of each 128-bit half into a group of four
+        __m256i secondLengths = _mm256_unpackhi_epi64(pairLengths, pairLengths);
+        __m256i quads = _mm256_or_si256(_mm256_sllv_epi64(_mm256_unpacklo_epi64(pairs, pairs), secondLengths),
+                                        _mm256_unpackhi_epi64(pairs, pairs));
+        __m256i quadLengths = _mm256_add_epi64(pairLengths, secondLengths);
+
+        unsigned long long q[4], l[4];
+        _mm256_storeu_si256((__m256i*)q, quads);
+        _mm256_storeu_si256((__m256i*)l, quadLengths);
+        groups[g] = q[0];
+        groups[g + 1] = q[2];
+        groupLengths[g] = (unsigned char)l[0];
+        groupLengths[g + 1] = (unsigned char)l[2];
+    }
+
+    // A last group of four
+    for (; i < count; i += 4, ++g) {
+        unsigned long long value = 0;
+        int length = 0;
+        for (int k = 0; k < 4; ++k) {
+            unsigned e = codes[data[i + k]];
+            value = (value << (e >> 24)) | (e & 0xFFFFFF);
+            length += (int)(e >> 24);
+        }
+        groups[g] = value;
+        groupLengths[g] = (unsigned char)length;
+    }
+}
+
+#endif
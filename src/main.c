@@ -1,25 +1,162 @@
 #include "huffman.h"
+#include "cli.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h> // For timing
 
-void printUsage() {
-    fprintf(stderr, "Usage: ./bin/huffman [mode] [input_file] [output_file]\n");
+static void printUsage(void) {
+    fprintf(stderr, "Usage: ./bin/huffman [options] [mode] [input_file] [output_file]\n");
+    fprintf(stderr, "       ./bin/huffman [--dict-id=N] -t [dictionary_file] [sample_file]...\n");
     fprintf(stderr, "Modes:\n");
     fprintf(stderr, "  -c : Compress\n");
     fprintf(stderr, "  -d : Decompress\n");
+    fprintf(stderr, "  -x : Extract a byte range of the original data (see --offset, --length;\n");
+    fprintf(stderr, "       not supported for shuffled arrays)\n");
+    fprintf(stderr, "  -t : Train a dictionary on sample files (see --dict)\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --decoder=table : Decode with multi-bit lookup tables (default)\n");
+    fprintf(stderr, "  --decoder=tree  : Decode by walking the tree bit by bit\n");
+    fprintf(stderr, "  --block-size=N  : Compress in independent blocks of N bytes (K/M/G suffixes)\n");
+    fprintf(stderr, "  --threads=N     : Worker threads for block mode (default: one per CPU)\n");
+    fprintf(stderr, "  --streams=N     : Bit streams per block, 1 or 4 (4 decodes faster; implies block mode)\n");
+    fprintf(stderr, "  --max-code-length=N : Longest code in bits, 8-15 (default: 15)\n");
+    fprintf(stderr, "  --offset=N      : First byte to extract with -x (default: 0)\n");
+    fprintf(stderr, "  --length=N      : Bytes to extract with -x (default: to the end)\n");
+    fprintf(stderr, "  --dict=FILE     : Compress with a trained dictionary; decompress data that uses it\n");
+    fprintf(stderr, "  --dict-id=N     : ID of the dictionary -t trains (default: derived from its code)\n");
+    fprintf(stderr, "  --stats         : Print per-stage times and coding statistics after -c or -d\n");
+}
+
+// Prints what a compression or decompression did (see --stats)
+static void printStats(const HuffStats* stats) {
+    printf("Stats:\n");
+    for (int s = 0; s < HUFF_STAGE_COUNT; ++s) {
+        printf("  %-10s %12llu ns\n", huffStageName((HuffStage)s), stats->stageNs[s]);
+    }
+    printf("  %-10s %12llu ns\n", "total", stats->totalNs);
+    printf("  Bytes in: %llu, bytes out: %llu", stats->bytesIn, stats->bytesOut);
+    if (stats->compress && stats->bytesIn > 0) {
+        printf(" (%.2f%%)", 100.0 * stats->bytesOut / stats->bytesIn);
+    }
+    printf("\n");
+    printf("  Symbols: %llu in %u block(s), %u distinct\n", stats->symbols, stats->blocks,
+           stats->distinctSymbols);
+    printf("  Average code length: %.4f bits", stats->averageCodeLength);
+    if (stats->compress) printf(" (entropy %.4f bits)", stats->entropy);
+    printf("\n");
+    printf("  Tree depth: %u\n", stats->treeDepth);
+    printf("  I/O calls: %llu read, %llu write, %llu mmap\n", stats->readCalls, stats->writeCalls,
+           stats->mapCalls);
 }
 
 int main(int argc, char* argv[]) {
+    // Options come before the mode
+    int argi = 1;
+    unsigned long long blockSize = 0;
+    int threads = -1;
+    int streams = 0;
+    int showStats = 0;
+    unsigned dictId = 0;
+    unsigned long long offset = 0, length = ~0ULL;
+    while (argi < argc && strncmp(argv[argi], "--", 2) == 0) {
+        const char* opt = argv[argi];
+        if (strcmp(opt, "--decoder=table") == 0) {
+            setDecoderMode(DECODER_TABLE);
+        } else if (strcmp(opt, "--decoder=tree") == 0) {
+            setDecoderMode(DECODER_TREE);
+        } else if (strncmp(opt, "--block-size=", 13) == 0) {
+            if (parseSize(opt + 13, &blockSize) != 0 || blockSize == 0 || blockSize > HUFF_MAX_BLOCK_SIZE) {
+                fprintf(stderr, "Error: Invalid block size '%s'\n", opt + 13);
+                return 1;
+            }
+        } else if (strncmp(opt, "--offset=", 9) == 0) {
+            if (parseSize(opt + 9, &offset) != 0) {
+                fprintf(stderr, "Error: Invalid offset '%s'\n", opt + 9);
+                return 1;
+            }
+        } else if (strncmp(opt, "--length=", 9) == 0) {
+            if (parseSize(opt + 9, &length) != 0) {
+                fprintf(stderr, "Error: Invalid length '%s'\n", opt + 9);
+                return 1;
+            }
+        } else if (strncmp(opt, "--streams=", 10) == 0) {
+            streams = atoi(opt + 10);
+            if (api_set_stream_count(streams) != 0) {
+                fprintf(stderr, "Error: Invalid stream count '%s'\n", opt + 10);
+                return 1;
+            }
+        } else if (strncmp(opt, "--max-code-length=", 18) == 0) {
+            char* end;
+            long maxLength = strtol(opt + 18, &end, 10);
+            if (end == opt + 18 || *end != '\0' || api_set_max_code_length((int)maxLength) != 0) {
+                fprintf(stderr, "Error: Invalid maximum code length '%s'\n", opt + 18);
+                return 1;
+            }
+        } else if (strncmp(opt, "--dict=", 7) == 0) {
+            long long id = api_load_dictionary(opt + 7);
+            if (id < 0 || api_set_dictionary((unsigned)id) != 0) return 1;
+        } else if (strncmp(opt, "--dict-id=", 10) == 0) {
+            char* end;
+            unsigned long long id = strtoull(opt + 10, &end, 10);
+            if (end == opt + 10 || *end != '\0' || id == 0 || id > 0xFFFFFFFFull) {
+                fprintf(stderr, "Error: Invalid dictionary ID '%s'\n", opt + 10);
+                return 1;
+            }
+            dictId = (unsigned)id;
+        } else if (strcmp(opt, "--stats") == 0) {
+            showStats = 1;
+        } else if (strncmp(opt, "--threads=", 10) == 0) {
+            threads = atoi(opt + 10);
+            if (threads < 1) {
+                fprintf(stderr, "Error: Invalid thread count '%s'\n", opt + 10);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Error: Invalid option '%s'\n", opt);
+            printUsage();
+            return 1;
+        }
+        argi++;
+    }
+
+    // Any block option turns on block mode
+    if (blockSize > 0 || threads > 0 || streams > 1) {
+        setBlockSize(blockSize > 0 ? (size_t)blockSize : HUFF_DEFAULT_BLOCK_SIZE);
+        setThreadCount(threads > 0 ? threads : 0);
+    }
+
+    // Training takes any number of samples
+    if (argi < argc && strcmp(argv[argi], "-t") == 0) {
+        if (argc - argi < 3) {
+            printUsage();
+            return 1;
+        }
+        printf("Mode: Train dictionary\n");
+        printf("Samples: %d file(s)\n", argc - argi - 2);
+        printf("Output: %s\n", argv[argi + 1]);
+        long long id = trainDictionaryFromFiles((const char* const*)(argv + argi + 2), argc - argi - 2, dictId,
+                                                argv[argi + 1]);
+        if (id < 0) {
+            fprintf(stderr, "Training failed.\n");
+            return 1;
+        }
+        printf("Dictionary ID: %lld\n", id);
+        return 0;
+    }
+
     // Basic argument parsing
-    if (argc != 4) {
+    if (argc - argi != 3) {
         printUsage();
         return 1;
     }
 
-    const char* mode = argv[1];
-    const char* inputPath = argv[2];
-    const char* outputPath = argv[3];
+    const char* mode = argv[argi];
+    const char* inputPath = argv[argi + 1];
+    const char* outputPath = argv[argi + 2];
+
+    HuffStats stats;
+    if (showStats) setStatsTarget(&stats);
 
     // Start timer
     clock_t start = clock();
@@ -34,6 +171,7 @@ int main(int argc, char* argv[]) {
             fprintf(stderr, "Compression failed.\n");
             return 1;
         }
+        if (showStats) printStats(&stats);
 
     } else if (strcmp(mode, "-d") == 0) {
         // --- Decompress Mode ---
@@ -45,6 +183,18 @@ int main(int argc, char* argv[]) {
             fprintf(stderr, "Decompression failed.\n");
             return 1;
         }
+        if (showStats) printStats(&stats);
+
+    } else if (strcmp(mode, "-x") == 0) {
+        // --- Extract Mode ---
+        printf("Mode: Extract\n");
+        printf("Input: %s\n", inputPath);
+        printf("Output: %s\n", outputPath);
+
+        if (api_extract_range(inputPath, outputPath, offset, length) != 0) {
+            fprintf(stderr, "Extraction failed.\n");
+            return 1;
+        }
 
     } else {
         // --- Invalid Mode ---
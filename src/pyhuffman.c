@@ -0,0 +1,372 @@
+// CPython extension module '_huffman' (built by `make python`): the buffer
+// and streaming APIs without the ctypes call overhead. Inputs are taken
+// through the buffer protocol and read in place, and the GIL is released
+// while the library codes. python/wrapper.py uses it when it is built and
+// falls back to ctypes otherwise.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "pythread.h"
+#include "huffman.h"
+
+// --- Helpers ---
+
+// Runs 'call' with the GIL released when the input is big enough for the
+// release to pay off (small messages are coded faster than a GIL handoff)
+#define RELEASE_GIL_MIN_SIZE 4096
+#define WITHOUT_GIL(size, call)                  \
+    do {                                         \
+        if ((size) >= RELEASE_GIL_MIN_SIZE) {    \
+            Py_BEGIN_ALLOW_THREADS call;         \
+            Py_END_ALLOW_THREADS                 \
+        } else {                                 \
+            call;                                \
+        }                                        \
+    } while (0)
+
+// Streaming objects are not thread-safe in the library, so each one has a
+// lock, taken without holding the GIL so that another thread using the
+// same object cannot deadlock with us
+static void acquireObjectLock(PyThread_type_lock lock) {
+    if (!PyThread_acquire_lock(lock, 0)) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(lock, 1);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+// --- Buffer Functions ---
+
+static PyObject* huffman_compress(PyObject* module, PyObject* args) {
+    (void)module;
+    Py_buffer src;
+    if (!PyArg_ParseTuple(args, "y*:compress", &src)) return NULL;
+
+    // 1. Compress into a bytes object of the worst-case size, then shrink it
+    size_t capacity = compressBufferBound((size_t)src.len);
+    PyObject* result = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)capacity);
+    if (!result) {
+        PyBuffer_Release(&src);
+        return NULL;
+    }
+    long long n;
+    unsigned char* dest = (unsigned char*)PyBytes_AS_STRING(result);
+    WITHOUT_GIL(src.len, n = compressBuffer((const unsigned char*)src.buf, (size_t)src.len, dest, capacity));
+    PyBuffer_Release(&src);
+
+    if (n < 0) {
+        Py_DECREF(result);
+        PyErr_SetString(PyExc_ValueError, "Huffman compression failed");
+        return NULL;
+    }
+    if (_PyBytes_Resize(&result, (Py_ssize_t)n) != 0) return NULL;
+    return result;
+}
+
+static PyObject* huffman_decompress(PyObject* module, PyObject* args) {
+    (void)module;
+    Py_buffer src;
+    if (!PyArg_ParseTuple(args, "y*:decompress", &src)) return NULL;
+
+    // 1. The result is allocated once, at the size in the header
+    long long size = decompressedSize((const unsigned char*)src.buf, (size_t)src.len);
+    if (size < 0 || size > PY_SSIZE_T_MAX) {
+        PyBuffer_Release(&src);
+        PyErr_SetString(PyExc_ValueError, "Not a valid compressed buffer or buffer is corrupted");
+        return NULL;
+    }
+    PyObject* result = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)size);
+    if (!result) {
+        PyBuffer_Release(&src);
+        return NULL;
+    }
+
+    // 2. Decode straight into it
+    long long n;
+    unsigned char* dest = (unsigned char*)PyBytes_AS_STRING(result);
+    WITHOUT_GIL(size, n = decompressBuffer((const unsigned char*)src.buf, (size_t)src.len, dest, (size_t)size));
+    PyBuffer_Release(&src);
+
+    if (n != size) {
+        Py_DECREF(result);
+        PyErr_SetString(PyExc_ValueError, "Compressed data is truncated or corrupted");
+        return NULL;
+    }
+    return result;
+}
+
+static PyObject* huffman_decompressed_size(PyObject* module, PyObject* args) {
+    (void)module;
+    Py_buffer src;
+    if (!PyArg_ParseTuple(args, "y*:decompressed_size", &src)) return NULL;
+    long long size = decompressedSize((const unsigned char*)src.buf, (size_t)src.len);
+    PyBuffer_Release(&src);
+    if (size < 0) {
+        PyErr_SetString(PyExc_ValueError, "Not a valid compressed buffer or buffer is corrupted");
+        return NULL;
+    }
+    return PyLong_FromLongLong(size);
+}
+
+// --- File Functions ---
+
+// Runs a file function of the API (0 or -1) on two path-like arguments
+static PyObject* runFileFunction(PyObject* args, const char* format, int (*function)(const char*, const char*)) {
+    PyObject *input, *output;
+    if (!PyArg_ParseTuple(args, format, PyUnicode_FSConverter, &input, PyUnicode_FSConverter, &output)) {
+        return NULL;
+    }
+    int rc;
+    Py_BEGIN_ALLOW_THREADS
+    rc = function(PyBytes_AS_STRING(input), PyBytes_AS_STRING(output));
+    Py_END_ALLOW_THREADS
+    Py_DECREF(input);
+    Py_DECREF(output);
+    return PyBool_FromLong(rc == 0);
+}
+
+static PyObject* huffman_compress_file(PyObject* module, PyObject* args) {
+    (void)module;
+    return runFileFunction(args, "O&O&:compress_file", api_compress_file);
+}
+
+static PyObject* huffman_decompress_file(PyObject* module, PyObject* args) {
+    (void)module;
+    return runFileFunction(args, "O&O&:decompress_file", api_decompress_file);
+}
+
+// --- Compressor ---
+
+typedef struct {
+    PyObject_HEAD
+    CompressStream* stream;
+    PyThread_type_lock lock;
+} CompressorObject;
+
+static int Compressor_init(CompressorObject* self, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = {"block_size", NULL};
+    unsigned long long blockSize = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|K:Compressor", keywords, &blockSize)) return -1;
+    if (blockSize > HUFF_MAX_BLOCK_SIZE) {
+        PyErr_SetString(PyExc_ValueError, "Invalid block size");
+        return -1;
+    }
+    if (self->stream) freeCompressStream(self->stream);
+    self->stream = createCompressStream((size_t)blockSize);
+    if (!self->stream) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    if (!self->lock && !(self->lock = PyThread_allocate_lock())) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+static void Compressor_dealloc(CompressorObject* self) {
+    freeCompressStream(self->stream);
+    if (self->lock) PyThread_free_lock(self->lock);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+// Wraps the output of a stream call (n bytes at 'out') in a bytes object
+static PyObject* streamOutput(long long n, const unsigned char* out, const char* error) {
+    if (n < 0) {
+        PyErr_SetString(PyExc_ValueError, error);
+        return NULL;
+    }
+    return PyBytes_FromStringAndSize((const char*)out, (Py_ssize_t)n);
+}
+
+static PyObject* Compressor_compress(CompressorObject* self, PyObject* args) {
+    Py_buffer data;
+    if (!PyArg_ParseTuple(args, "y*:compress", &data)) return NULL;
+    if (!self->stream) {
+        PyBuffer_Release(&data);
+        PyErr_SetString(PyExc_ValueError, "Compressor is not initialized");
+        return NULL;
+    }
+    long long n;
+    const unsigned char* out = NULL;
+    acquireObjectLock(self->lock);
+    WITHOUT_GIL(data.len, n = compressStreamFeed(self->stream, (const unsigned char*)data.buf, (size_t)data.len, &out));
+    PyObject* result = streamOutput(n, out, "Huffman compression failed (compressor already ended?)");
+    PyThread_release_lock(self->lock);
+    PyBuffer_Release(&data);
+    return result;
+}
+
+// flush() and end(): either may code a whole pending block
+static PyObject* runCompressorCall(CompressorObject* self, long long (*call)(CompressStream*, const unsigned char**)) {
+    if (!self->stream) {
+        PyErr_SetString(PyExc_ValueError, "Compressor is not initialized");
+        return NULL;
+    }
+    long long n;
+    const unsigned char* out = NULL;
+    acquireObjectLock(self->lock);
+    Py_BEGIN_ALLOW_THREADS
+    n = call(self->stream, &out);
+    Py_END_ALLOW_THREADS
+    PyObject* result = streamOutput(n, out, "Huffman compression failed (compressor already ended?)");
+    PyThread_release_lock(self->lock);
+    return result;
+}
+
+static PyObject* Compressor_flush(CompressorObject* self, PyObject* unused) {
+    (void)unused;
+    return runCompressorCall(self, compressStreamFlush);
+}
+
+static PyObject* Compressor_end(CompressorObject* self, PyObject* unused) {
+    (void)unused;
+    return runCompressorCall(self, compressStreamEnd);
+}
+
+static PyMethodDef Compressor_methods[] = {
+    {"compress", (PyCFunction)Compressor_compress, METH_VARARGS,
+     "compress(data) -> bytes\n\nFeeds data; returns the compressed bytes of the blocks it completed."},
+    {"flush", (PyCFunction)Compressor_flush, METH_NOARGS,
+     "flush() -> bytes\n\nCodes the data fed so far, so a reader can decode all of it."},
+    {"end", (PyCFunction)Compressor_end, METH_NOARGS,
+     "end() -> bytes\n\nFlushes and writes the end marker; the compressor takes no more input."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyTypeObject CompressorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_huffman.Compressor",
+    .tp_basicsize = sizeof(CompressorObject),
+    .tp_dealloc = (destructor)Compressor_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Compressor(block_size=0)\n\nIncremental compression into a block container "
+              "(block_size 0 = 1 MB blocks).",
+    .tp_methods = Compressor_methods,
+    .tp_init = (initproc)Compressor_init,
+    .tp_new = PyType_GenericNew,
+};
+
+// --- Decompressor ---
+
+typedef struct {
+    PyObject_HEAD
+    DecompressStream* stream;
+    PyThread_type_lock lock;
+} DecompressorObject;
+
+static int Decompressor_init(DecompressorObject* self, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = {NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, ":Decompressor", keywords)) return -1;
+    if (self->stream) freeDecompressStream(self->stream);
+    self->stream = createDecompressStream();
+    if (!self->stream) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    if (!self->lock && !(self->lock = PyThread_allocate_lock())) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+static void Decompressor_dealloc(DecompressorObject* self) {
+    freeDecompressStream(self->stream);
+    if (self->lock) PyThread_free_lock(self->lock);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* Decompressor_decompress(DecompressorObject* self, PyObject* args) {
+    Py_buffer data;
+    if (!PyArg_ParseTuple(args, "y*:decompress", &data)) return NULL;
+    if (!self->stream) {
+        PyBuffer_Release(&data);
+        PyErr_SetString(PyExc_ValueError, "Decompressor is not initialized");
+        return NULL;
+    }
+    long long n;
+    const unsigned char* out = NULL;
+    acquireObjectLock(self->lock);
+    WITHOUT_GIL(data.len, n = decompressStreamFeed(self->stream, (const unsigned char*)data.buf, (size_t)data.len, &out));
+    PyObject* result = streamOutput(n, out, "Compressed data is truncated or corrupted");
+    PyThread_release_lock(self->lock);
+    PyBuffer_Release(&data);
+    return result;
+}
+
+static PyObject* Decompressor_end(DecompressorObject* self, PyObject* unused) {
+    (void)unused;
+    if (!self->stream) {
+        PyErr_SetString(PyExc_ValueError, "Decompressor is not initialized");
+        return NULL;
+    }
+    acquireObjectLock(self->lock);
+    int rc = decompressStreamEnd(self->stream);
+    PyThread_release_lock(self->lock);
+    if (rc != 0) {
+        PyErr_SetString(PyExc_ValueError, "Compressed data is truncated or corrupted");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef Decompressor_methods[] = {
+    {"decompress", (PyCFunction)Decompressor_decompress, METH_VARARGS,
+     "decompress(data) -> bytes\n\nFeeds compressed data; returns the bytes of the blocks it completed."},
+    {"end", (PyCFunction)Decompressor_end, METH_NOARGS,
+     "end()\n\nRaises ValueError unless the whole container was fed."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyTypeObject DecompressorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_huffman.Decompressor",
+    .tp_basicsize = sizeof(DecompressorObject),
+    .tp_dealloc = (destructor)Decompressor_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Decompressor()\n\nIncremental decompression of block containers.",
+    .tp_methods = Decompressor_methods,
+    .tp_init = (initproc)Decompressor_init,
+    .tp_new = PyType_GenericNew,
+};
+
+// --- Module ---
+
+static PyMethodDef huffmanMethods[] = {
+    {"compress", huffman_compress, METH_VARARGS,
+     "compress(data) -> bytes\n\nCompresses a buffer-protocol object with the current settings."},
+    {"decompress", huffman_decompress, METH_VARARGS,
+     "decompress(data) -> bytes\n\nDecompresses a buffer-protocol object."},
+    {"decompressed_size", huffman_decompressed_size, METH_VARARGS,
+     "decompressed_size(data) -> int\n\nOriginal size stored in a compressed buffer's header."},
+    {"compress_file", huffman_compress_file, METH_VARARGS,
+     "compress_file(input_path, output_path) -> bool"},
+    {"decompress_file", huffman_decompress_file, METH_VARARGS,
+     "decompress_file(input_path, output_path) -> bool"},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef huffmanModule = {
+    PyModuleDef_HEAD_INIT,
+    "_huffman",
+    "Native bindings of the Huffman compression library.",
+    -1,
+    huffmanMethods,
+    NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit__huffman(void) {
+    if (PyType_Ready(&CompressorType) < 0 || PyType_Ready(&DecompressorType) < 0) return NULL;
+    PyObject* module = PyModule_Create(&huffmanModule);
+    if (!module) return NULL;
+    Py_INCREF(&CompressorType);
+    Py_INCREF(&DecompressorType);
+    if (PyModule_AddObject(module, "Compressor", (PyObject*)&CompressorType) < 0 ||
+        PyModule_AddObject(module, "Decompressor", (PyObject*)&DecompressorType) < 0) {
+        Py_DECREF(&CompressorType);
+        Py_DECREF(&DecompressorType);
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
@@ -0,0 +1,851 @@
+// Library tests: round trips through every container type (HUFF, HUF2,
+// HUFS, HUFB, HUFT) and every API (buffer, file, stream, context, batch,
+// range), plus empty, exact-capacity and corrupt input. Prints each failed
+// check and exits non-zero if any failed. Run with `make test`; -v keeps
+// the library's own messages, which are silenced otherwise.
+#include "huffman.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_DIR "build" // Scratch files go next to the objects
+
+// Magic numbers of the containers (see huffman.c)
+#define MAGIC_LEGACY 0x48554646u    // 'HUFF'
+#define MAGIC_CANONICAL 0x48554632u // 'HUF2'
+#define MAGIC_STATIC 0x48554653u    // 'HUFS'
+#define MAGIC_BLOCKS 0x48554642u    // 'HUFB'
+#define MAGIC_SHUFFLED 0x48554654u  // 'HUFT'
+
+static FILE* report; // stdout as it was before the library was silenced
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(cond, ...)                                        \
+    do {                                                        \
+        ++checks;                                               \
+        if (!(cond)) {                                          \
+            ++failures;                                         \
+            fprintf(report, "FAIL %s:%d: ", __FILE__, __LINE__); \
+            fprintf(report, __VA_ARGS__);                       \
+            fprintf(report, "\n");                              \
+        }                                                       \
+    } while (0)
+
+// --- Helpers ---
+
+static int sameBytes(const unsigned char* a, size_t aSize, const unsigned char* b, size_t bSize) {
+    return aSize == bSize && (aSize == 0 || memcmp(a, b, aSize) == 0);
+}
+
+static unsigned magicOf(const unsigned char* data, size_t size) {
+    unsigned magic = 0;
+    if (size >= sizeof(unsigned)) memcpy(&magic, data, sizeof(unsigned));
+    return magic;
+}
+
+static unsigned char* allocBytes(size_t size) {
+    unsigned char* data = (unsigned char*)malloc(size + 1);
+    if (!data) {
+        perror("malloc error (allocBytes)");
+        exit(EXIT_FAILURE);
+    }
+    return data;
+}
+
+// Growable byte buffer, for stream output
+typedef struct Bytes {
+    unsigned char* data;
+    size_t size, capacity;
+} Bytes;
+
+static void appendBytes(Bytes* b, const unsigned char* data, size_t size) {
+    if (b->size + size > b->capacity) {
+        size_t capacity = b->capacity ? b->capacity : 4096;
+        while (b->size + size > capacity) capacity *= 2;
+        unsigned char* grown = (unsigned char*)realloc(b->data, capacity);
+        if (!grown) {
+            perror("malloc error (appendBytes)");
+            exit(EXIT_FAILURE);
+        }
+        b->data = grown;
+        b->capacity = capacity;
+    }
+    if (size > 0) memcpy(b->data + b->size, data, size);
+    b->size += size;
+}
+
+static int writeFile(const char* path, const unsigned char* data, size_t size) {
+    FILE* out = fopen(path, "wb");
+    if (!out) return -1;
+    int failed = fwrite(data, 1, size, out) != size;
+    if (fclose(out) != 0) failed = 1;
+    return failed ? -1 : 0;
+}
+
+// Whole file in a malloc'd buffer, or NULL if it cannot be read
+static unsigned char* readFile(const char* path, size_t* size) {
+    FILE* in = fopen(path, "rb");
+    if (!in) return NULL;
+    Bytes b = {NULL, 0, 0};
+    unsigned char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0) appendBytes(&b, chunk, n);
+    fclose(in);
+    if (!b.data) b.data = allocBytes(0);
+    *size = b.size;
+    return b.data;
+}
+
+static int fileExists(const char* path) {
+    return access(path, F_OK) == 0;
+}
+
+// Sends stdout and stderr to /dev/null; checks report through 'report'
+static void silenceLibrary(void) {
+    fflush(stdout);
+    fflush(stderr);
+    int fd = open("/dev/null", O_WRONLY);
+    if (fd < 0) return;
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+}
+
+// --- Inputs ---
+
+typedef struct TestInput {
+    const char* name;
+    unsigned char* data;
+    size_t size;
+} TestInput;
+
+enum { INPUT_EMPTY, INPUT_ONE, INPUT_TINY, INPUT_TEXT, INPUT_SKEWED, INPUT_LONG_CODES, INPUT_RUN,
+       INPUT_RANDOM, INPUT_COUNT };
+static TestInput inputs[INPUT_COUNT];
+
+// Deterministic generator (xorshift64*), so every run sees the same data
+static unsigned long long nextRandom(unsigned long long* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+static void makeInputs(void) {
+    static const char* words[] = {"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog, ",
+                                  "and ", "then ", "sleeps. ", "Huffman ", "codes ", "bytes\n"};
+    unsigned long long state = 0x9E3779B97F4A7C15ull;
+    for (int k = 0; k < INPUT_COUNT; ++k) inputs[k].data = NULL;
+
+    inputs[INPUT_EMPTY] = (TestInput){"empty", allocBytes(0), 0};
+    inputs[INPUT_ONE] = (TestInput){"one byte", allocBytes(1), 1};
+    inputs[INPUT_ONE].data[0] = 'x';
+    inputs[INPUT_TINY] = (TestInput){"tiny", allocBytes(11), 11};
+    memcpy(inputs[INPUT_TINY].data, "abracadabra", 11);
+
+    // Text: words in random order
+    TestInput* t = &inputs[INPUT_TEXT];
+    *t = (TestInput){"text", allocBytes(200000), 200000};
+    for (size_t i = 0; i < t->size;) {
+        const char* w = words[nextRandom(&state) % (sizeof(words) / sizeof(words[0]))];
+        for (size_t j = 0; w[j] && i < t->size; ++j) t->data[i++] = (unsigned char)w[j];
+    }
+
+    // Skewed: every byte value, small ones far more often
+    TestInput* s = &inputs[INPUT_SKEWED];
+    *s = (TestInput){"skewed", allocBytes(300000), 300000};
+    for (size_t i = 0; i < s->size; ++i) {
+        unsigned long long r = nextRandom(&state);
+        s->data[i] = (unsigned char)((r & 0xFF) % (1 + (r >> 8) % 64));
+    }
+
+    // Long codes: frequencies doubling every other symbol, shuffled, so the
+    // deepest codes hit the length limit
+    TestInput* l = &inputs[INPUT_LONG_CODES];
+    size_t size = 0;
+    for (int c = 0; c < 36; ++c) size += (size_t)1 << (c / 2);
+    *l = (TestInput){"long codes", allocBytes(size), size};
+    size_t pos = 0;
+    for (int c = 0; c < 36; ++c) {
+        for (size_t j = 0; j < ((size_t)1 << (c / 2)); ++j) l->data[pos++] = (unsigned char)(c * 7);
+    }
+    for (size_t i = size - 1; i > 0; --i) {
+        size_t j = (size_t)(nextRandom(&state) % (i + 1));
+        unsigned char tmp = l->data[i];
+        l->data[i] = l->data[j];
+        l->data[j] = tmp;
+    }
+
+    // One repeated byte (RLE blocks) and noise (stored blocks)
+    inputs[INPUT_RUN] = (TestInput){"run", allocBytes(100000), 100000};
+    memset(inputs[INPUT_RUN].data, 'a', 100000);
+    TestInput* r = &inputs[INPUT_RANDOM];
+    *r = (TestInput){"random", allocBytes(100000), 100000};
+    for (size_t i = 0; i < r->size; ++i) r->data[i] = (unsigned char)(nextRandom(&state) >> 56);
+}
+
+// --- Settings ---
+
+typedef struct TestConfig {
+    const char* name;
+    size_t blockSize;
+    int streams;
+    int maxCodeLength;
+} TestConfig;
+
+static const TestConfig configs[] = {
+    {"single stream", 0, 1, 15},
+    {"single stream, 8-bit codes", 0, 1, 8},
+    {"blocks", 64 * 1024, 1, 15},
+    {"blocks, 4 streams", 64 * 1024, HUFF_INTERLEAVED_STREAMS, 15},
+    {"small blocks, 11-bit codes", 1000, 1, 11},
+};
+#define CONFIG_COUNT (int)(sizeof(configs) / sizeof(configs[0]))
+
+static void applyConfig(const TestConfig* config) {
+    setBlockSize(config->blockSize);
+    setStreamCount(config->streams);
+    setMaxCodeLength(config->maxCodeLength);
+    setDecoderMode(DECODER_TABLE);
+}
+
+// Container a config writes: single streams fall back to a block
+// container for stored and RLE data
+static int expectedMagic(const TestConfig* config, unsigned magic) {
+    if (config->blockSize > 0) return magic == MAGIC_BLOCKS;
+    return magic == MAGIC_CANONICAL || magic == MAGIC_BLOCKS;
+}
+
+// --- Buffer API ---
+
+// Decodes 'compressed' with both decoders and every buffer entry point
+static void checkDecodes(const unsigned char* compressed, size_t size, const TestInput* input, const char* what) {
+    CHECK(decompressedSize(compressed, size) == (long long)input->size, "%s: decompressedSize", what);
+    unsigned char* out = allocBytes(input->size);
+    DecoderMode modes[] = {DECODER_TABLE, DECODER_TREE};
+    for (int m = 0; m < 2; ++m) {
+        setDecoderMode(modes[m]);
+        long long n = decompressBuffer(compressed, size, out, input->size);
+        CHECK(n == (long long)input->size && sameBytes(out, (size_t)n, input->data, input->size),
+              "%s: decompressBuffer (%s decoder)", what, m == 0 ? "table" : "tree");
+        size_t allocSize = 0;
+        unsigned char* alloc = decompressBufferAlloc(compressed, size, &allocSize);
+        CHECK(alloc && sameBytes(alloc, allocSize, input->data, input->size),
+              "%s: decompressBufferAlloc (%s decoder)", what, m == 0 ? "table" : "tree");
+        free(alloc);
+    }
+    setDecoderMode(DECODER_TABLE);
+    if (input->size > 0) {
+        CHECK(decompressBuffer(compressed, size, out, input->size - 1) == -1, "%s: decompressBuffer into too little",
+              what);
+    }
+    free(out);
+}
+
+static void testBuffers(void) {
+    for (int c = 0; c < CONFIG_COUNT; ++c) {
+        applyConfig(&configs[c]);
+        for (int k = 0; k < INPUT_COUNT; ++k) {
+            const TestInput* input = &inputs[k];
+            char what[128];
+            snprintf(what, sizeof(what), "buffer %s, %s", configs[c].name, input->name);
+
+            size_t bound = compressBufferBound(input->size);
+            unsigned char* compressed = allocBytes(bound);
+            long long n = compressBuffer(input->data, input->size, compressed, bound);
+            CHECK(n >= 0, "%s: compressBuffer", what);
+            if (n < 0) {
+                free(compressed);
+                continue;
+            }
+            CHECK(expectedMagic(&configs[c], magicOf(compressed, (size_t)n)), "%s: container %08x", what,
+                  magicOf(compressed, (size_t)n));
+
+            // A destination of exactly the output size is enough; one byte less is not
+            unsigned char* exact = allocBytes((size_t)n);
+            CHECK(compressBuffer(input->data, input->size, exact, (size_t)n) == n &&
+                  sameBytes(exact, (size_t)n, compressed, (size_t)n), "%s: exact-capacity compressBuffer", what);
+            if (n > 0) {
+                CHECK(compressBuffer(input->data, input->size, exact, (size_t)n - 1) == -1,
+                      "%s: compressBuffer into too little", what);
+            }
+            free(exact);
+
+            size_t allocSize = 0;
+            unsigned char* alloc = compressBufferAlloc(input->data, input->size, &allocSize);
+            CHECK(alloc && sameBytes(alloc, allocSize, compressed, (size_t)n), "%s: compressBufferAlloc", what);
+            free(alloc);
+
+            checkDecodes(compressed, (size_t)n, input, what);
+            free(compressed);
+        }
+    }
+
+    // Older versions wrote empty inputs as empty files
+    unsigned char none[1];
+    size_t size = 1;
+    unsigned char* alloc = decompressBufferAlloc(none, 0, &size);
+    CHECK(alloc && size == 0, "buffer: empty compressed buffer");
+    free(alloc);
+    CHECK(decompressBuffer(none, 0, none, 0) == 0, "buffer: decompressBuffer of an empty buffer");
+}
+
+// --- Shuffled Arrays ---
+
+static void testShuffled(void) {
+    applyConfig(&configs[0]);
+    size_t widths[] = {1, 2, 3, 4, 8};
+    size_t size = 40007; // Not a multiple of any width but 1
+    unsigned char* data = allocBytes(size);
+    for (size_t i = 0; i < size / 4; ++i) {
+        unsigned value = (unsigned)(i * 37 + (i % 5));
+        memcpy(data + 4 * i, &value, sizeof(unsigned));
+    }
+    memset(data + size / 4 * 4, 0x5A, size % 4);
+
+    HuffContext* ctx = createHuffContext();
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+        for (int empty = 0; empty < 2; ++empty) {
+            TestInput input = {"shuffled", data, empty ? 0 : size};
+            char what[64];
+            snprintf(what, sizeof(what), "shuffled width %zu%s", widths[w], empty ? ", empty" : "");
+
+            size_t bound = compressShuffledBound(input.size, widths[w]);
+            unsigned char* compressed = allocBytes(bound);
+            long long n = compressShuffled(input.data, input.size, widths[w], compressed, bound);
+            CHECK(n > 0 && magicOf(compressed, (size_t)n) == MAGIC_SHUFFLED, "%s: compressShuffled", what);
+            if (n <= 0) {
+                free(compressed);
+                continue;
+            }
+            unsigned char* exact = allocBytes((size_t)n);
+            CHECK(compressShuffled(input.data, input.size, widths[w], exact, (size_t)n) == n &&
+                  compressShuffled(input.data, input.size, widths[w], exact, (size_t)n - 1) == -1,
+                  "%s: exact-capacity compressShuffled", what);
+            free(exact);
+
+            checkDecodes(compressed, (size_t)n, &input, what);
+            const unsigned char* out = NULL;
+            long long m = contextDecompress(ctx, compressed, (size_t)n, &out);
+            CHECK(m == (long long)input.size && sameBytes(out, (size_t)m, input.data, input.size),
+                  "%s: contextDecompress", what);
+
+            // Files decode whole; ranges are not supported
+            CHECK(writeFile(TEST_DIR "/test_shuffled.huff", compressed, (size_t)n) == 0, "%s: write", what);
+            size_t restoredSize = 0;
+            unsigned char* restored = NULL;
+            CHECK(decompressFile(TEST_DIR "/test_shuffled.huff", TEST_DIR "/test_shuffled.out") == 0 &&
+                  (restored = readFile(TEST_DIR "/test_shuffled.out", &restoredSize)) != NULL &&
+                  sameBytes(restored, restoredSize, input.data, input.size), "%s: decompressFile", what);
+            free(restored);
+            if (input.size > 0) {
+                unsigned char byte;
+                CHECK(readRange(TEST_DIR "/test_shuffled.huff", 0, 1, &byte) == -1, "%s: readRange fails", what);
+            }
+            free(compressed);
+        }
+    }
+    freeHuffContext(ctx);
+    free(data);
+}
+
+// --- Dictionaries ---
+
+static void testDictionary(void) {
+    applyConfig(&configs[0]);
+    const TestInput* text = &inputs[INPUT_TEXT];
+    const char* path = TEST_DIR "/test.dict";
+    long long id = trainDictionary(text->data, text->size / 2, 0, path);
+    CHECK(id > 0 && hasDictionary((unsigned)id), "dictionary: trainDictionary");
+    if (id <= 0) return;
+    setDictionary((unsigned)id);
+
+    // Messages of the trained distribution use it; data it codes in more
+    // than 8 bits a byte gets a table of its own
+    const TestInput* messages[] = {&inputs[INPUT_TINY], text, &inputs[INPUT_SKEWED]};
+    const unsigned magics[] = {MAGIC_STATIC, MAGIC_STATIC, MAGIC_CANONICAL};
+    unsigned char* compressed[3];
+    size_t sizes[3];
+    for (int k = 0; k < 3; ++k) {
+        char what[64];
+        snprintf(what, sizeof(what), "dictionary, %s", messages[k]->name);
+        compressed[k] = compressBufferAlloc(messages[k]->data, messages[k]->size, &sizes[k]);
+        CHECK(compressed[k] && magicOf(compressed[k], sizes[k]) == magics[k], "%s: compress", what);
+        if (compressed[k]) checkDecodes(compressed[k], sizes[k], messages[k], what);
+    }
+
+    // The reader needs the dictionary registered
+    setDictionary(0);
+    clearDictionaries();
+    size_t size;
+    unsigned char* out = compressed[0] ? decompressBufferAlloc(compressed[0], sizes[0], &size) : NULL;
+    CHECK(out == NULL, "dictionary: decoding without the dictionary fails");
+    free(out);
+    CHECK(loadDictionary(path) == id, "dictionary: loadDictionary");
+    if (compressed[1]) checkDecodes(compressed[1], sizes[1], text, "dictionary, reloaded");
+
+    for (int k = 0; k < 3; ++k) free(compressed[k]);
+    clearDictionaries();
+}
+
+// --- Legacy Format ---
+
+// Writes 'input' in the legacy HUFF format (frequency table, then the
+// codes of the tree it builds), which this version only reads
+static unsigned char* encodeLegacy(const TestInput* input, size_t* size) {
+    unsigned long long freqTable[256] = {0};
+    countFrequencies(input->data, input->size, freqTable);
+    HuffTree tree;
+    HuffCode codes[256];
+    memset(codes, 0, sizeof(codes));
+    if (buildHuffmanTree(freqTable, &tree) != 0 || generateCodeTable(&tree, tree.root, codes, 0, 0) != 0) {
+        return NULL;
+    }
+
+    size_t header = sizeof(unsigned) + sizeof(unsigned long long) + sizeof(freqTable);
+    unsigned char* out = allocBytes(header + input->size * 8 + 8);
+    unsigned magic = MAGIC_LEGACY;
+    unsigned long long count = input->size;
+    memcpy(out, &magic, sizeof(unsigned));
+    memcpy(out + sizeof(unsigned), &count, sizeof(count));
+    memcpy(out + sizeof(unsigned) + sizeof(count), freqTable, sizeof(freqTable));
+
+    // Codes MSB first, zero-padded to a byte
+    size_t pos = header;
+    unsigned acc = 0;
+    int bits = 0;
+    for (size_t i = 0; i < input->size; ++i) {
+        HuffCode code = codes[input->data[i]];
+        for (int b = code.length - 1; b >= 0; --b) {
+            acc = (acc << 1) | (unsigned)((code.bits >> b) & 1);
+            if (++bits == 8) {
+                out[pos++] = (unsigned char)acc;
+                acc = 0;
+                bits = 0;
+            }
+        }
+    }
+    if (bits > 0) out[pos++] = (unsigned char)(acc << (8 - bits));
+    *size = pos;
+    return out;
+}
+
+static void testLegacy(void) {
+    applyConfig(&configs[0]);
+    const int legacyInputs[] = {INPUT_TINY, INPUT_TEXT, INPUT_SKEWED};
+    for (int k = 0; k < 3; ++k) {
+        const TestInput* input = &inputs[legacyInputs[k]];
+        char what[64];
+        snprintf(what, sizeof(what), "legacy, %s", input->name);
+        size_t size;
+        unsigned char* compressed = encodeLegacy(input, &size);
+        CHECK(compressed != NULL, "%s: encode", what);
+        if (!compressed) continue;
+        checkDecodes(compressed, size, input, what);
+
+        CHECK(writeFile(TEST_DIR "/test_legacy.huff", compressed, size) == 0, "%s: write", what);
+        size_t restoredSize = 0;
+        unsigned char* restored = NULL;
+        CHECK(decompressFile(TEST_DIR "/test_legacy.huff", TEST_DIR "/test_legacy.out") == 0 &&
+              (restored = readFile(TEST_DIR "/test_legacy.out", &restoredSize)) != NULL &&
+              sameBytes(restored, restoredSize, input->data, input->size), "%s: decompressFile", what);
+        free(restored);
+        free(compressed);
+    }
+}
+
+// --- File API ---
+
+// Checks ranges of a compressed file of 'input', with readRange and extractRange
+static void checkRanges(const char* path, const TestInput* input, const char* what) {
+    unsigned long long size = input->size;
+    unsigned long long ranges[][2] = {{0, 1}, {0, size}, {size / 3, size / 2}, {size - 1, 1}, {size / 2, size}};
+    unsigned char* dest = allocBytes(input->size);
+    for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); ++r) {
+        unsigned long long offset = ranges[r][0], length = ranges[r][1];
+        unsigned long long expected = (offset + length > size) ? size - offset : length; // Clamped to the end
+        long long n = readRange(path, offset, length, dest);
+        CHECK(n == (long long)expected && sameBytes(dest, (size_t)n, input->data + offset, (size_t)expected),
+              "%s: readRange(%llu, %llu)", what, offset, length);
+
+        size_t outSize = 0;
+        unsigned char* out = NULL;
+        CHECK(extractRange(path, TEST_DIR "/test_range.out", offset, length) == 0 &&
+              (out = readFile(TEST_DIR "/test_range.out", &outSize)) != NULL &&
+              sameBytes(out, outSize, input->data + offset, (size_t)expected),
+              "%s: extractRange(%llu, %llu)", what, offset, length);
+        free(out);
+    }
+    free(dest);
+}
+
+static void testFiles(void) {
+    const char* inputPath = TEST_DIR "/test_input.bin";
+    const char* compressedPath = TEST_DIR "/test_file.huff";
+    const char* outputPath = TEST_DIR "/test_file.out";
+    HuffContext* ctx = createHuffContext();
+    for (int c = 0; c < CONFIG_COUNT; ++c) {
+        applyConfig(&configs[c]);
+        for (int k = 0; k < INPUT_COUNT; ++k) {
+            const TestInput* input = &inputs[k];
+            char what[128];
+            snprintf(what, sizeof(what), "file %s, %s", configs[c].name, input->name);
+            if (writeFile(inputPath, input->data, input->size) != 0) {
+                CHECK(0, "%s: write input", what);
+                continue;
+            }
+
+            for (int useContext = 0; useContext < 2; ++useContext) {
+                int rc = useContext ? contextCompressFile(ctx, inputPath, compressedPath)
+                                    : compressFile(inputPath, compressedPath);
+                CHECK(rc == 0, "%s: compressFile%s", what, useContext ? " (context)" : "");
+                rc = useContext ? contextDecompressFile(ctx, compressedPath, outputPath)
+                                : decompressFile(compressedPath, outputPath);
+                size_t size = 0;
+                unsigned char* restored = NULL;
+                CHECK(rc == 0 && (restored = readFile(outputPath, &size)) != NULL &&
+                      sameBytes(restored, size, input->data, input->size),
+                      "%s: decompressFile%s", what, useContext ? " (context)" : "");
+                free(restored);
+            }
+
+            // The file and buffer APIs write the same container
+            size_t fileSize = 0, bufferSize = 0;
+            unsigned char* file = readFile(compressedPath, &fileSize);
+            unsigned char* buffer = compressBufferAlloc(input->data, input->size, &bufferSize);
+            CHECK(file && buffer && sameBytes(file, fileSize, buffer, bufferSize), "%s: same as the buffer API",
+                  what);
+            free(file);
+            free(buffer);
+
+            if (input->size > 1 && (k == INPUT_TEXT || k == INPUT_TINY)) checkRanges(compressedPath, input, what);
+
+            // A file cut inside its first block fails and leaves no output
+            // behind; cut anywhere else it fails or restores the input
+            // (a container cut in its index still has every block)
+            if (input->size > 0 && fileSize > 17) {
+                file = readFile(compressedPath, &fileSize);
+                size_t cuts[] = {17, fileSize / 2, fileSize - 1};
+                for (int i = 0; file && i < 3; ++i) {
+                    writeFile(compressedPath, file, cuts[i]);
+                    remove(outputPath);
+                    int rc = decompressFile(compressedPath, outputPath);
+                    size_t size = 0;
+                    unsigned char* restored = rc == 0 ? readFile(outputPath, &size) : NULL;
+                    CHECK((rc == -1 && !fileExists(outputPath)) ||
+                          (i > 0 && restored && sameBytes(restored, size, input->data, input->size)),
+                          "%s: file cut to %zu bytes", what, cuts[i]);
+                    free(restored);
+                }
+                free(file);
+            }
+        }
+    }
+    freeHuffContext(ctx);
+    CHECK(compressFile(TEST_DIR "/no_such_file", compressedPath) == -1, "file: missing input");
+    CHECK(decompressFile(inputPath, outputPath) == -1, "file: not a compressed file");
+}
+
+// --- Streaming API ---
+
+static void testStreams(void) {
+    applyConfig(&configs[2]);
+    for (int k = 0; k < INPUT_COUNT; ++k) {
+        const TestInput* input = &inputs[k];
+        char what[64];
+        snprintf(what, sizeof(what), "stream, %s", input->name);
+
+        // Fed in odd-sized chunks, with a flush halfway
+        CompressStream* stream = createCompressStream(10000);
+        Bytes compressed = {NULL, 0, 0};
+        const unsigned char* out;
+        long long n;
+        int ok = 1;
+        for (size_t pos = 0; ok && pos < input->size; pos += 777) {
+            size_t chunk = input->size - pos < 777 ? input->size - pos : 777;
+            n = compressStreamFeed(stream, input->data + pos, chunk, &out);
+            if (n < 0) ok = 0;
+            else appendBytes(&compressed, out, (size_t)n);
+            if (pos < input->size / 2 && pos + chunk >= input->size / 2) {
+                n = compressStreamFlush(stream, &out);
+                if (n < 0) ok = 0;
+                else appendBytes(&compressed, out, (size_t)n);
+            }
+        }
+        n = ok ? compressStreamEnd(stream, &out) : -1;
+        if (n >= 0) appendBytes(&compressed, out, (size_t)n);
+        CHECK(n >= 0 && magicOf(compressed.data, compressed.size) == MAGIC_BLOCKS, "%s: compress", what);
+        CHECK(compressStreamFeed(stream, input->data, input->size, &out) == -1, "%s: feed after end", what);
+        freeCompressStream(stream);
+        if (n < 0) {
+            free(compressed.data);
+            continue;
+        }
+
+        // The buffer and file APIs read streamed containers
+        checkDecodes(compressed.data, compressed.size, input, what);
+        writeFile(TEST_DIR "/test_stream.huff", compressed.data, compressed.size);
+        size_t size = 0;
+        unsigned char* restored = NULL;
+        CHECK(decompressFile(TEST_DIR "/test_stream.huff", TEST_DIR "/test_stream.out") == 0 &&
+              (restored = readFile(TEST_DIR "/test_stream.out", &size)) != NULL &&
+              sameBytes(restored, size, input->data, input->size), "%s: decompressFile", what);
+        free(restored);
+
+        // Decompressed in small chunks, and truncated by a byte
+        for (int truncated = 0; truncated < 2; ++truncated) {
+            DecompressStream* d = createDecompressStream();
+            Bytes decoded = {NULL, 0, 0};
+            size_t end = compressed.size - (size_t)truncated;
+            ok = 1;
+            for (size_t pos = 0; ok && pos < end; pos += 333) {
+                size_t chunk = end - pos < 333 ? end - pos : 333;
+                n = decompressStreamFeed(d, compressed.data + pos, chunk, &out);
+                if (n < 0) ok = 0;
+                else appendBytes(&decoded, out, (size_t)n);
+            }
+            if (truncated) {
+                CHECK(decompressStreamEnd(d) == -1, "%s: truncated stream", what);
+            } else {
+                CHECK(ok && decompressStreamEnd(d) == 0 && sameBytes(decoded.data, decoded.size, input->data,
+                                                                    input->size), "%s: decompress stream", what);
+            }
+            freeDecompressStream(d);
+            free(decoded.data);
+        }
+        free(compressed.data);
+    }
+
+    // Containers the buffer API writes stream too
+    size_t size;
+    unsigned char* compressed = compressBufferAlloc(inputs[INPUT_TEXT].data, inputs[INPUT_TEXT].size, &size);
+    DecompressStream* d = createDecompressStream();
+    const unsigned char* out;
+    long long n = compressed ? decompressStreamFeed(d, compressed, size, &out) : -1;
+    CHECK(n >= 0 && decompressStreamEnd(d) == 0 &&
+          sameBytes(out, (size_t)n, inputs[INPUT_TEXT].data, inputs[INPUT_TEXT].size), "stream: buffer container");
+    freeDecompressStream(d);
+    free(compressed);
+}
+
+// --- Compression Context ---
+
+static void testContext(void) {
+    HuffContext* ctx = createHuffContext();
+    CHECK(ctx != NULL, "context: createHuffContext");
+    if (!ctx) return;
+    for (int round = 0; round < 2; ++round) {
+        for (int c = 0; c < CONFIG_COUNT; ++c) {
+            applyConfig(&configs[c]);
+            for (int k = 0; k < INPUT_COUNT; ++k) {
+                const TestInput* input = &inputs[k];
+                char what[128];
+                snprintf(what, sizeof(what), "context %s, %s", configs[c].name, input->name);
+                const unsigned char* out = NULL;
+                long long n = contextCompress(ctx, input->data, input->size, &out);
+                size_t size = 0;
+                unsigned char* expected = compressBufferAlloc(input->data, input->size, &size);
+                CHECK(n >= 0 && expected && sameBytes(out, (size_t)n, expected, size), "%s: contextCompress", what);
+
+                const unsigned char* decoded = NULL;
+                long long m = expected ? contextDecompress(ctx, expected, size, &decoded) : -1;
+                CHECK(m == (long long)input->size && sameBytes(decoded, (size_t)m, input->data, input->size),
+                      "%s: contextDecompress", what);
+                free(expected);
+            }
+        }
+    }
+    freeHuffContext(ctx);
+}
+
+// --- Batch API ---
+
+static void testBatch(void) {
+    applyConfig(&configs[3]);
+    enum { ITEMS = 5 };
+    const int items[ITEMS] = {INPUT_TEXT, INPUT_EMPTY, INPUT_SKEWED, INPUT_RUN, INPUT_TINY};
+
+    // Files: one input is missing and fails on its own
+    char inputPaths[ITEMS + 1][64], compressedPaths[ITEMS + 1][64], outputPaths[ITEMS + 1][64];
+    const char* in[ITEMS + 1];
+    const char* compressed[ITEMS + 1];
+    const char* out[ITEMS + 1];
+    for (int i = 0; i <= ITEMS; ++i) {
+        snprintf(inputPaths[i], sizeof(inputPaths[i]), TEST_DIR "/test_batch%d.bin", i);
+        snprintf(compressedPaths[i], sizeof(compressedPaths[i]), TEST_DIR "/test_batch%d.huff", i);
+        snprintf(outputPaths[i], sizeof(outputPaths[i]), TEST_DIR "/test_batch%d.out", i);
+        in[i] = inputPaths[i];
+        compressed[i] = compressedPaths[i];
+        out[i] = outputPaths[i];
+        if (i < ITEMS) writeFile(inputPaths[i], inputs[items[i]].data, inputs[items[i]].size);
+    }
+    remove(inputPaths[ITEMS]);
+    int results[ITEMS + 1];
+    CHECK(compressFiles(in, compressed, ITEMS + 1, 2, results) == 1 && results[ITEMS] == -1,
+          "batch: compressFiles with a missing input");
+    CHECK(decompressFiles(compressed, out, ITEMS, 2, results) == 0, "batch: decompressFiles");
+    for (int i = 0; i < ITEMS; ++i) {
+        size_t size = 0;
+        unsigned char* restored = readFile(outputPaths[i], &size);
+        CHECK(results[i] == 0 && restored && sameBytes(restored, size, inputs[items[i]].data, inputs[items[i]].size),
+              "batch: file %d", i);
+        free(restored);
+    }
+
+    // Buffers: one corrupt item fails on its own
+    const unsigned char* srcs[ITEMS + 1];
+    size_t srcSizes[ITEMS + 1];
+    unsigned char* outputs[ITEMS + 1];
+    size_t outputSizes[ITEMS + 1];
+    for (int i = 0; i < ITEMS; ++i) {
+        srcs[i] = inputs[items[i]].data;
+        srcSizes[i] = inputs[items[i]].size;
+    }
+    CHECK(compressBuffers(srcs, srcSizes, ITEMS, 2, outputs, outputSizes) == 0, "batch: compressBuffers");
+    unsigned char* packed[ITEMS];
+    for (int i = 0; i < ITEMS; ++i) {
+        packed[i] = outputs[i];
+        srcs[i] = outputs[i] ? outputs[i] : inputs[INPUT_EMPTY].data;
+        srcSizes[i] = outputs[i] ? outputSizes[i] : 0;
+    }
+    srcs[ITEMS] = inputs[INPUT_RANDOM].data;
+    srcSizes[ITEMS] = 64;
+    CHECK(decompressBuffers(srcs, srcSizes, ITEMS + 1, 2, outputs, outputSizes) == 1 && outputs[ITEMS] == NULL,
+          "batch: decompressBuffers with a corrupt item");
+    for (int i = 0; i < ITEMS; ++i) {
+        CHECK(packed[i] && outputs[i] &&
+              sameBytes(outputs[i], outputSizes[i], inputs[items[i]].data, inputs[items[i]].size),
+              "batch: buffer %d", i);
+        free(outputs[i]);
+        free(packed[i]);
+    }
+}
+
+// --- Corrupt Input ---
+
+// Decodes damaged data through every buffer entry point: it must fail or
+// produce exactly the size it claims, never crash or read out of bounds
+static int decodesCleanly(HuffContext* ctx, const unsigned char* data, size_t size) {
+    size_t allocSize = 0;
+    unsigned char* alloc = decompressBufferAlloc(data, size, &allocSize);
+    const unsigned char* out;
+    long long n = contextDecompress(ctx, data, size, &out);
+    long long claimed = decompressedSize(data, size);
+    int clean = (alloc == NULL || (long long)allocSize == claimed) && (n == -1 || n == claimed);
+    free(alloc);
+    return clean;
+}
+
+static void testCorrupt(void) {
+    HuffContext* ctx = createHuffContext();
+    unsigned long long state = 12345;
+    const int corruptConfigs[] = {0, 2, 3};
+    for (int c = 0; c < 3; ++c) {
+        const TestConfig* config = &configs[corruptConfigs[c]];
+        applyConfig(config);
+        const TestInput* input = &inputs[INPUT_TEXT];
+        size_t size;
+        unsigned char* compressed = compressBufferAlloc(input->data, input->size, &size);
+        if (!compressed) {
+            CHECK(0, "corrupt %s: compress", config->name);
+            continue;
+        }
+
+        // A truncated buffer fails, or restores the input if only the
+        // index was cut
+        unsigned char* damaged = allocBytes(size);
+        int truncatedOk = 1;
+        for (size_t cut = 1; cut < size; ++cut) {
+            if (cut > 64 && size - cut > 64 && cut % 997 != 0) continue; // Every cut near either end
+            size_t n;
+            unsigned char* out = decompressBufferAlloc(compressed, cut, &n);
+            if (out && !sameBytes(out, n, input->data, input->size)) truncatedOk = 0;
+            free(out);
+        }
+        CHECK(truncatedOk, "corrupt %s: truncated buffers", config->name);
+
+        // Flipped bits fail or decode to the claimed size
+        int flipsOk = 1;
+        for (int f = 0; f < 300; ++f) {
+            memcpy(damaged, compressed, size);
+            size_t bit = (size_t)(nextRandom(&state) % (size * 8));
+            damaged[bit / 8] ^= (unsigned char)(1u << (bit % 8));
+            if (!decodesCleanly(ctx, damaged, size)) flipsOk = 0;
+        }
+        CHECK(flipsOk, "corrupt %s: flipped bits", config->name);
+
+        // A forged char count is rejected before anything is allocated for it
+        unsigned long long forged = 0x7fffffffffffff00ull;
+        memcpy(damaged, compressed, size);
+        memcpy(damaged + sizeof(unsigned), &forged, sizeof(forged));
+        size_t n;
+        unsigned char* out = decompressBufferAlloc(damaged, size, &n);
+        CHECK(out == NULL && decompressedSize(damaged, size) == -1, "corrupt %s: forged char count", config->name);
+        free(out);
+        free(damaged);
+        free(compressed);
+    }
+
+    // A forged count in a short block container, and in a shuffled array
+    unsigned char header[30] = {0};
+    unsigned magic = MAGIC_BLOCKS;
+    unsigned long long forged = 0x7fffffffffffff00ull;
+    memcpy(header, &magic, sizeof(magic));
+    memcpy(header + sizeof(magic), &forged, sizeof(forged));
+    size_t n;
+    unsigned char* out = decompressBufferAlloc(header, sizeof(header), &n);
+    const unsigned char* view;
+    CHECK(out == NULL && contextDecompress(ctx, header, sizeof(header), &view) == -1, "corrupt: forged HUFB");
+    free(out);
+
+    size_t bound = compressShuffledBound(inputs[INPUT_SKEWED].size, 4);
+    unsigned char* shuffled = allocBytes(bound);
+    long long size = compressShuffled(inputs[INPUT_SKEWED].data, inputs[INPUT_SKEWED].size, 4, shuffled, bound);
+    if (size > 0) {
+        memcpy(shuffled + sizeof(unsigned), &forged, sizeof(forged));
+        out = decompressBufferAlloc(shuffled, (size_t)size, &n);
+        CHECK(out == NULL && contextDecompress(ctx, shuffled, (size_t)size, &view) == -1, "corrupt: forged HUFT");
+        free(out);
+    }
+    free(shuffled);
+
+    // Not compressed data at all
+    out = decompressBufferAlloc(inputs[INPUT_TEXT].data, 1000, &n);
+    CHECK(out == NULL && decompressedSize(inputs[INPUT_TEXT].data, 1000) == -1, "corrupt: not a container");
+    free(out);
+    freeHuffContext(ctx);
+}
+
+int main(int argc, char* argv[]) {
+    int verbose = (argc > 1 && strcmp(argv[1], "-v") == 0);
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    if (!report) {
+        perror("Failed to open report stream");
+        return EXIT_FAILURE;
+    }
+    setvbuf(report, NULL, _IOLBF, 0);
+    if (!verbose) silenceLibrary();
+
+    makeInputs();
+    static const struct {
+        const char* name;
+        void (*run)(void);
+    } suites[] = {
+        {"buffers", testBuffers},   {"shuffled", testShuffled}, {"dictionary", testDictionary},
+        {"legacy", testLegacy},     {"files", testFiles},       {"streams", testStreams},
+        {"context", testContext},   {"batch", testBatch},       {"corrupt", testCorrupt},
+    };
+    for (size_t s = 0; s < sizeof(suites) / sizeof(suites[0]); ++s) {
+        int before = failures;
+        suites[s].run();
+        fprintf(report, "%-10s %s\n", suites[s].name, failures == before ? "ok" : "FAILED");
+    }
+    for (int k = 0; k < INPUT_COUNT; ++k) free(inputs[k].data);
+
+    fprintf(report, "%d checks, %d failed\n", checks, failures);
+    fclose(report);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
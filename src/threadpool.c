@@ -0,0 +1,137 @@
+#include "threadpool.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// A queued job (singly linked FIFO)
+typedef struct JobNode {
+    ThreadJob job;
+    void* arg;
+    struct JobNode* next;
+} JobNode;
+
+struct ThreadPool {
+    pthread_t* threads;
+    int threadCount;
+
+    pthread_mutex_t lock;
+    pthread_cond_t workAvailable; // Signalled when a job is queued or on shutdown
+    pthread_cond_t allDone;       // Signalled when the last pending job finishes
+
+    JobNode *head, *tail;
+    unsigned pending;             // Jobs queued or running
+    int stopping;
+};
+
+int onlineCpuCount(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static void* workerMain(void* arg) {
+    ThreadPool* pool = (ThreadPool*)arg;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->head == NULL && !pool->stopping) {
+            pthread_cond_wait(&pool->workAvailable, &pool->lock);
+        }
+        if (pool->head == NULL) break; // Stopping and nothing left to do
+
+        JobNode* node = pool->head;
+        pool->head = node->next;
+        if (pool->head == NULL) pool->tail = NULL;
+
+        pthread_mutex_unlock(&pool->lock);
+        node->job(node->arg);
+        free(node);
+        pthread_mutex_lock(&pool->lock);
+
+        if (--pool->pending == 0) pthread_cond_broadcast(&pool->allDone);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+ThreadPool* createThreadPool(int threads) {
+    if (threads <= 0) threads = onlineCpuCount();
+
+    ThreadPool* pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    if (!pool) {
+        perror("malloc error (createThreadPool)");
+        return NULL;
+    }
+    pool->threads = (pthread_t*)malloc(threads * sizeof(pthread_t));
+    if (!pool->threads) {
+        perror("malloc error (createThreadPool)");
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->workAvailable, NULL);
+    pthread_cond_init(&pool->allDone, NULL);
+
+    // Make do with the workers that could be started
+    for (int i = 0; i < threads; ++i) {
+        if (pthread_create(&pool->threads[i], NULL, workerMain, pool) != 0) break;
+        pool->threadCount++;
+    }
+    if (pool->threadCount == 0) {
+        perror("pthread_create error (createThreadPool)");
+        freeThreadPool(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+int threadPoolSize(ThreadPool* pool) {
+    return pool->threadCount;
+}
+
+int submitJob(ThreadPool* pool, ThreadJob job, void* arg) {
+    JobNode* node = (JobNode*)malloc(sizeof(JobNode));
+    if (!node) return -1;
+    node->job = job;
+    node->arg = arg;
+    node->next = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail) {
+        pool->tail->next = node;
+    } else {
+        pool->head = node;
+    }
+    pool->tail = node;
+    pool->pending++;
+    pthread_cond_signal(&pool->workAvailable);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void waitForJobs(ThreadPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->allDone, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void freeThreadPool(ThreadPool* pool) {
+    if (pool == NULL) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->workAvailable);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->threadCount; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->allDone);
+    pthread_cond_destroy(&pool->workAvailable);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,31 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+// --- Thread Pool ---
+// A fixed set of worker threads that run submitted jobs in FIFO order.
+
+typedef void (*ThreadJob)(void* arg);
+
+typedef struct ThreadPool ThreadPool;
+
+// Number of online CPUs (at least 1)
+int onlineCpuCount(void);
+
+// Starts 'threads' workers (one per online CPU if threads <= 0), or as many
+// of them as the system allows. Returns NULL if none can be started.
+ThreadPool* createThreadPool(int threads);
+
+// Number of worker threads in the pool
+int threadPoolSize(ThreadPool* pool);
+
+// Queues job(arg) to run on a worker. Returns 0, or -1 (the job is not
+// queued) if memory runs out.
+int submitJob(ThreadPool* pool, ThreadJob job, void* arg);
+
+// Blocks until every submitted job has finished
+void waitForJobs(ThreadPool* pool);
+
+// Waits for queued jobs, then stops and frees the workers
+void freeThreadPool(ThreadPool* pool);
+
+#endif // THREADPOOL_H